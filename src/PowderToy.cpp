@@ -10,6 +10,7 @@
 #include "common/platform/Platform.h"
 #include "graphics/Graphics.h"
 #include "simulation/SaveRenderer.h"
+#include "simulation/gravity/Gravity.h"
 #include "common/tpt-rand.h"
 #include "gui/game/Favorite.h"
 #include "gui/Style.h"
@@ -269,6 +270,7 @@ int main(int argc, char * argv[])
 	}
 	// We're now in the correct directory, time to get prefs.
 	explicitSingletons->globalPrefs = std::make_unique<GlobalPrefs>();
+	Gravity::SetFftWisdomFile("fftw.wisdom");
 
 	auto &prefs = GlobalPrefs::Ref();
 	scale = prefs.Get("Scale", 1);
@@ -0,0 +1,243 @@
+#include "common/String.h"
+#include "common/tpt-rand.h"
+#include "client/GameSave.h"
+#include "simulation/Simulation.h"
+#include "simulation/Air.h"
+#include "simulation/gravity/Gravity.h"
+#include "common/platform/Platform.h"
+#include "X86KillDenormals.h"
+#include "Config.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// FNV-1a over the simulation state that a tick can change. Particle fields are
+// hashed one by one rather than as raw memory so the digest doesn't depend on
+// the layout of Particle.
+class StateDigest
+{
+	uint64_t hash = UINT64_C(0xcbf29ce484222325);
+
+public:
+	void Add(const void *data, size_t size)
+	{
+		auto *bytes = reinterpret_cast<const unsigned char *>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= UINT64_C(0x100000001b3);
+		}
+	}
+
+	template<class Item>
+	void Add(const Item &item)
+	{
+		Add(&item, sizeof(item));
+	}
+
+	uint64_t Get() const
+	{
+		return hash;
+	}
+};
+
+static uint64_t Digest(const Simulation &sim)
+{
+	StateDigest digest;
+	for (int i = 0; i <= sim.parts_lastActiveIndex; i++)
+	{
+		auto &part = sim.parts[i];
+		if (!part.type)
+		{
+			continue;
+		}
+		digest.Add(i);
+		digest.Add(part.type);
+		digest.Add(part.life);
+		digest.Add(part.ctype);
+		digest.Add(part.x);
+		digest.Add(part.y);
+		digest.Add(part.vx);
+		digest.Add(part.vy);
+		digest.Add(part.temp);
+		digest.Add(part.tmp3);
+		digest.Add(part.tmp4);
+		digest.Add(part.flags);
+		digest.Add(part.tmp);
+		digest.Add(part.tmp2);
+		digest.Add(part.dcolour);
+	}
+	digest.Add(sim.air->pv, sizeof(sim.air->pv));
+	digest.Add(sim.air->vx, sizeof(sim.air->vx));
+	digest.Add(sim.air->vy, sizeof(sim.air->vy));
+	digest.Add(sim.air->hv, sizeof(sim.air->hv));
+	return digest.Get();
+}
+
+static ByteString DigestString(const Simulation &sim)
+{
+	return ByteString::Build(Format::Hex(), Format::Width(16), Format::Fill('0'), Digest(sim));
+}
+
+static void Usage(const char *argv0)
+{
+	std::cout << "Usage: " << argv0 << " <inputFilename> [options]" << std::endl;
+	std::cout << "  --ticks=N              ticks to run, 1000 by default" << std::endl;
+	std::cout << "  --seed=N               RNG seed, 1 by default" << std::endl;
+	std::cout << "  --threads=N            see Simulation::SetUpdateThreads, 1 by default" << std::endl;
+	std::cout << "  --sleep                enable sleeping regions" << std::endl;
+	std::cout << "  --compact-interval=N   see Simulation::SetCompactInterval, 0 by default" << std::endl;
+	std::cout << "  --pipelined-air        run air on its own thread" << std::endl;
+	std::cout << "  --heat-grid            enable the grid-based heat conduction pass" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	using Argument = std::optional<ByteString>;
+	std::map<ByteString, Argument> arguments;
+	std::optional<ByteString> inputArg;
+	for (auto i = 1; i < argc; ++i)
+	{
+		auto str = ByteString(argv[i]);
+		if (!str.BeginsWith("--"))
+		{
+			if (inputArg)
+			{
+				Usage(argv[0]);
+				return 1;
+			}
+			inputArg = str;
+		}
+		else if (auto split = ByteString(str.substr(2)).SplitBy('='))
+		{
+			arguments.insert({ split.Before(), split.After() });
+		}
+		else
+		{
+			arguments.insert({ ByteString(str.substr(2)), std::nullopt });
+		}
+	}
+	for (auto &[ name, value ] : arguments)
+	{
+		auto takesValue = name == "ticks" || name == "seed" || name == "threads" || name == "compact-interval";
+		auto isFlag = name == "sleep" || name == "pipelined-air" || name == "heat-grid";
+		if (!(takesValue && value) && !(isFlag && !value))
+		{
+			std::cerr << "invalid option --" << name << std::endl;
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!inputArg)
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+	auto valueArg = [&arguments](ByteString name) -> const char * {
+		auto it = arguments.find(name);
+		return it != arguments.end() ? it->second->c_str() : nullptr;
+	};
+	auto intArg = [&valueArg](ByteString name, int defaultValue) {
+		auto *value = valueArg(name);
+		return value ? std::atoi(value) : defaultValue;
+	};
+	auto flagArg = [&arguments](ByteString name) {
+		return arguments.find(name) != arguments.end();
+	};
+	auto inputFilename = *inputArg;
+	int ticks = intArg("ticks", 1000);
+	unsigned int seed = valueArg("seed") ? std::strtoul(valueArg("seed"), nullptr, 10) : 1U;
+	int threads = intArg("threads", 1);
+	bool sleep = flagArg("sleep");
+	int compactInterval = intArg("compact-interval", 0);
+	bool pipelinedAir = flagArg("pipelined-air");
+	bool heatGrid = flagArg("heat-grid");
+	if (ticks <= 0)
+	{
+		std::cerr << "tick count must be positive" << std::endl;
+		return 1;
+	}
+	if (threads <= 0)
+	{
+		std::cerr << "thread count must be positive" << std::endl;
+		return 1;
+	}
+	if (compactInterval < 0)
+	{
+		std::cerr << "compact interval must not be negative" << std::endl;
+		return 1;
+	}
+
+	if constexpr (X86)
+	{
+		X86KillDenormals();
+	}
+
+	std::vector<char> fileData;
+	if (!Platform::ReadFile(fileData, inputFilename))
+	{
+		return 1;
+	}
+
+	std::unique_ptr<GameSave> gameSave;
+	try
+	{
+		gameSave = std::make_unique<GameSave>(fileData, false);
+	}
+	catch (ParseException &e)
+	{
+		std::cerr << "failed to load " << inputFilename << ": " << e.what() << std::endl;
+		return 1;
+	}
+
+	auto rng = std::make_unique<RNG>();
+	// A fixed seed makes the final digest comparable between runs and builds,
+	// as long as newtonian gravity, which runs on its own thread, is off.
+	rng->seed(seed);
+	random_gen.seed(seed);
+	auto sim = std::make_unique<Simulation>();
+
+	// Same as GameModel::SetSave, minus the pause state.
+	sim->gravityMode = gameSave->gravityMode;
+	sim->customGravityX = gameSave->customGravityX;
+	sim->customGravityY = gameSave->customGravityY;
+	sim->air->airMode = gameSave->airMode;
+	sim->air->ambientAirTemp = gameSave->ambientAirTemp;
+	sim->edgeMode = gameSave->edgeMode;
+	sim->legacy_enable = gameSave->legacyEnable;
+	sim->water_equal_test = gameSave->waterEEnabled;
+	sim->aheat_enable = gameSave->aheatEnable;
+	if (gameSave->gravityEnable)
+	{
+		sim->grav->start_grav_async();
+	}
+	sim->clear_sim();
+	sim->Load(gameSave.get(), true);
+	sim->sys_pause = 0;
+	sim->SetUpdateThreads(threads);
+	sim->SetSleepingRegions(sleep);
+	sim->SetCompactInterval(compactInterval);
+	sim->air->SetPipelined(pipelinedAir);
+	sim->SetHeatGrid(heatGrid);
+
+	std::cout << "loaded " << inputFilename << ", " << sim->NUM_PARTS << " particles, digest " << DigestString(*sim) << std::endl;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int tick = 0; tick < ticks; tick++)
+	{
+		sim->BeforeSim();
+		sim->UpdateParticles(0, NPART);
+		sim->AfterSim();
+	}
+	auto end = std::chrono::steady_clock::now();
+	auto seconds = std::chrono::duration<double>(end - start).count();
+
+	std::cout << ticks << " ticks in " << seconds << " s, " << (ticks / seconds) << " ticks/s" << std::endl;
+	std::cout << sim->NUM_PARTS << " particles, digest " << DigestString(*sim) << std::endl;
+	return 0;
+}
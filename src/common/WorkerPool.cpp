@@ -0,0 +1,89 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int threadCount) : nextIndex(0)
+{
+	for (int i = 1; i < threadCount; i++)
+	{
+		threads.emplace_back([this]() {
+			ThreadMain();
+		});
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	startCv.notify_all();
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+}
+
+void WorkerPool::RunJob()
+{
+	while (true)
+	{
+		auto index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+		if (index >= jobCount)
+		{
+			break;
+		}
+		(*job)(index);
+	}
+}
+
+void WorkerPool::ThreadMain()
+{
+	unsigned int seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			startCv.wait(lock, [this, seenGeneration]() {
+				return stopping || generation != seenGeneration;
+			});
+			if (stopping)
+			{
+				return;
+			}
+			seenGeneration = generation;
+		}
+		RunJob();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busyThreads -= 1;
+		}
+		doneCv.notify_one();
+	}
+}
+
+void WorkerPool::ParallelFor(int count, const std::function<void (int)> &newJob)
+{
+	if (threads.empty() || count <= 1)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			newJob(i);
+		}
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &newJob;
+		jobCount = count;
+		nextIndex.store(0, std::memory_order_relaxed);
+		busyThreads = int(threads.size());
+		generation += 1;
+	}
+	startCv.notify_all();
+	RunJob();
+	std::unique_lock<std::mutex> lock(mutex);
+	doneCv.wait(lock, [this]() {
+		return busyThreads == 0;
+	});
+	job = nullptr;
+}
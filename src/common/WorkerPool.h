@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that split up the iterations of a loop between them.
+// The thread calling ParallelFor takes part in the work, so a pool of N threads
+// only starts N - 1 of its own.
+class WorkerPool
+{
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable startCv;
+	std::condition_variable doneCv;
+	bool stopping = false;
+	unsigned int generation = 0;
+	int busyThreads = 0;
+
+	const std::function<void (int)> *job = nullptr;
+	int jobCount = 0;
+	std::atomic<int> nextIndex;
+
+	void RunJob();
+	void ThreadMain();
+
+public:
+	WorkerPool(int threadCount);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator =(const WorkerPool &) = delete;
+
+	int GetThreadCount() const
+	{
+		return int(threads.size()) + 1;
+	}
+
+	// Calls job(0) through job(count - 1), in no particular order, and returns when all calls have returned.
+	void ParallelFor(int count, const std::function<void (int)> &job);
+};
@@ -63,3 +63,76 @@ void RNGType::seed(unsigned int sd)
 }
 
 RNGType random_gen;
+
+static inline uint32_t mulhilo(uint32_t a, uint32_t b, uint32_t &hi)
+{
+	uint64_t product = uint64_t(a) * b;
+	hi = uint32_t(product >> 32);
+	return uint32_t(product);
+}
+
+void CounterRNG::Block(const uint32_t key[2], const uint32_t counter[4], uint32_t out[4])
+{
+	uint32_t k0 = key[0], k1 = key[1];
+	uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+	for (int round = 0; round < 10; round++)
+	{
+		uint32_t hi0, hi1;
+		uint32_t lo0 = mulhilo(0xD2511F53U, c0, hi0);
+		uint32_t lo1 = mulhilo(0xCD9E8D57U, c2, hi1);
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+		k0 += 0x9E3779B9U;
+		k1 += 0xBB67AE85U;
+	}
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+CounterRNG::CounterRNG(uint64_t newKey, uint32_t tick, uint32_t index, uint32_t site):
+	key{ uint32_t(newKey), uint32_t(newKey >> 32) },
+	counter{ tick, index, site, 0 },
+	used(4)
+{
+}
+
+void CounterRNG::refill()
+{
+	Block(key, counter, block);
+	counter[3]++;
+	used = 0;
+}
+
+unsigned int CounterRNG::operator()()
+{
+	if (used == 4)
+		refill();
+	return block[used++];
+}
+
+unsigned int CounterRNG::gen()
+{
+	return (*this)() & 0x7FFFFFFF;
+}
+
+int CounterRNG::between(int lower, int upper)
+{
+	unsigned int r = (*this)();
+	return static_cast<int>(r % (upper - lower + 1)) + lower;
+}
+
+bool CounterRNG::chance(int nominator, unsigned int denominator)
+{
+	if (nominator < 0)
+		return false;
+	return (*this)() % denominator < static_cast<unsigned int>(nominator);
+}
+
+float CounterRNG::uniform01()
+{
+	return static_cast<float>((*this)())/(float)0xFFFFFFFF;
+}
@@ -24,3 +24,31 @@ class RNG : public RNGType, public ExplicitSingleton<RNG>
 };
 
 extern RNGType random_gen;
+
+// Philox4x32-10, from "Parallel Random Numbers: As Easy as 1, 2, 3" by Salmon et al.
+// The stream depends only on the key and the counter it is constructed with, so code that
+// builds its counter from the tick, the particle ID and the call site gets the same numbers
+// no matter which thread runs it or in what order.
+class CounterRNG
+{
+private:
+	uint32_t key[2];
+	uint32_t counter[4];
+	uint32_t block[4];
+	int used;
+
+	void refill();
+
+public:
+	// The four numbers for one key and counter. Blocks for different counters are independent,
+	// so loops generating many of them at once are free to vectorise.
+	static void Block(const uint32_t key[2], const uint32_t counter[4], uint32_t out[4]);
+
+	CounterRNG(uint64_t newKey, uint32_t tick, uint32_t index, uint32_t site);
+
+	unsigned int operator()();
+	unsigned int gen();
+	int between(int lower, int upper);
+	bool chance(int nominator, unsigned int denominator);
+	float uniform01();
+};
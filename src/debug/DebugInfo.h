@@ -8,6 +8,8 @@ public:
 	virtual ~DebugInfo() { }
 	unsigned int debugID;
 	virtual void Draw() {}
+	// Called when the overlay is switched on or off with tpt.setdebug
+	virtual void SetEnabled(bool enabled) {}
 	// currentMouse doesn't belong but I don't want to create more hooks at the moment
 	virtual bool KeyPress(int key, int scan, bool shift, bool ctrl, bool alt, ui::Point currentMouse) { return true; }
 };
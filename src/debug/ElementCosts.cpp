@@ -0,0 +1,64 @@
+#include "ElementCosts.h"
+
+#include "gui/interface/Engine.h"
+
+#include "simulation/Simulation.h"
+
+#include "graphics/Graphics.h"
+
+#include <algorithm>
+#include <vector>
+
+ElementCostsDebug::ElementCostsDebug(unsigned int id, Simulation * sim):
+	DebugInfo(id),
+	sim(sim)
+{
+
+}
+
+void ElementCostsDebug::SetEnabled(bool enabled)
+{
+	sim->profiler.SetElementTiming(enabled);
+}
+
+void ElementCostsDebug::Draw()
+{
+	Graphics * g = ui::Engine::Ref().g;
+
+	auto &profiler = sim->profiler;
+	std::vector<int> ranked;
+	for (int t = 1; t < PT_NUM; t++)
+	{
+		if (sim->elements[t].Enabled && profiler.GetElementCost(t).TotalTime() > 0.0005f)
+			ranked.push_back(t);
+	}
+	std::sort(ranked.begin(), ranked.end(), [&profiler](int a, int b) {
+		return profiler.GetElementCost(a).TotalTime() > profiler.GetElementCost(b).TotalTime();
+	});
+	constexpr int maxRows = 20;
+	if (ranked.size() > maxRows)
+		ranked.resize(maxRows);
+
+	int lineHeight = 12;
+	int xStart = XRES - 250, yStart = 60;
+	int columns[] = { xStart, xStart + 40, xStart + 100, xStart + 150, xStart + 200 };
+	g->fillrect(xStart - 5, yStart - 5, 250, int(ranked.size() + 1) * lineHeight + 8, 0, 0, 0, 180);
+	g->drawtext(columns[0], yStart, "Elem", 255, 255, 255, 255);
+	g->drawtext(columns[1], yStart, "Updates", 255, 255, 255, 255);
+	g->drawtext(columns[2], yStart, "ms", 255, 255, 255, 255);
+	g->drawtext(columns[3], yStart, "Draws", 255, 255, 255, 255);
+	g->drawtext(columns[4], yStart, "ms", 255, 255, 255, 255);
+
+	int y = yStart + lineHeight;
+	for (auto t : ranked)
+	{
+		auto &cost = profiler.GetElementCost(t);
+		auto colour = sim->elements[t].Colour;
+		g->drawtext(columns[0], y, sim->elements[t].Name, PIXR(colour), PIXG(colour), PIXB(colour), 255);
+		g->drawtext(columns[1], y, String::Build(int(cost.calls[SimulationProfiler::functionUpdate] + 0.5f)), 255, 255, 255, 255);
+		g->drawtext(columns[2], y, String::Build(Format::Fixed(), Format::Precision(2), cost.time[SimulationProfiler::functionUpdate]), 255, 255, 255, 255);
+		g->drawtext(columns[3], y, String::Build(int(cost.calls[SimulationProfiler::functionGraphics] + 0.5f)), 255, 255, 255, 255);
+		g->drawtext(columns[4], y, String::Build(Format::Fixed(), Format::Precision(2), cost.time[SimulationProfiler::functionGraphics]), 255, 255, 255, 255);
+		y += lineHeight;
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "DebugInfo.h"
+
+class Simulation;
+class ElementCostsDebug : public DebugInfo
+{
+	Simulation * sim;
+public:
+	ElementCostsDebug(unsigned int id, Simulation * sim);
+	void Draw() override;
+	void SetEnabled(bool enabled) override;
+};
@@ -0,0 +1,49 @@
+#include "SimulationProfile.h"
+
+#include "gui/interface/Engine.h"
+
+#include "simulation/Simulation.h"
+
+#include "graphics/Graphics.h"
+
+SimulationProfileDebug::SimulationProfileDebug(unsigned int id, Simulation * sim):
+	DebugInfo(id),
+	sim(sim)
+{
+
+}
+
+void SimulationProfileDebug::Draw()
+{
+	Graphics * g = ui::Engine::Ref().g;
+
+	auto &profiler = sim->profiler;
+	auto frame = profiler.GetFrameTime();
+	float scale = frame.average > 0 ? 100.0f / frame.average : 0.0f;
+
+	int xStart = 10, yStart = 60;
+	int lineHeight = 12, barX = xStart + 170;
+	g->fillrect(xStart - 5, yStart - 5, 280, (SimulationProfiler::phaseCount + 1) * lineHeight + 8, 0, 0, 0, 180);
+	g->drawtext(xStart, yStart, String::Build(Format::Fixed(), Format::Precision(2), "Frame: ", frame.average, " ms (last ", frame.last, ")"), 255, 255, 255, 255);
+
+	int y = yStart + lineHeight;
+	for (int i = 0; i < SimulationProfiler::phaseCount; i++)
+	{
+		auto phase = SimulationProfiler::Phase(i);
+		auto &time = profiler.GetTime(phase);
+		// phases between beforeSim and updateParticles are parts of beforeSim
+		bool child = phase > SimulationProfiler::phaseBeforeSim && phase < SimulationProfiler::phaseUpdateParticles;
+		int x = child ? xStart + 10 : xStart;
+		g->drawtext(x, y, ByteString(SimulationProfiler::PhaseName(phase)).FromUtf8(), 255, 255, 255, 255);
+		g->drawtext(xStart + 110, y, String::Build(Format::Fixed(), Format::Precision(2), time.average), 255, 255, 255, 255);
+		int barWidth = int(time.average * scale + 0.5f);
+		if (barWidth > 0)
+		{
+			if (child)
+				g->fillrect(barX, y + 1, barWidth, 7, 160, 160, 255, 200);
+			else
+				g->fillrect(barX, y + 1, barWidth, 7, 255, 255, 255, 200);
+		}
+		y += lineHeight;
+	}
+}
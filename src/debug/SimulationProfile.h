@@ -0,0 +1,12 @@
+#pragma once
+
+#include "DebugInfo.h"
+
+class Simulation;
+class SimulationProfileDebug : public DebugInfo
+{
+	Simulation * sim;
+public:
+	SimulationProfileDebug(unsigned int id, Simulation * sim);
+	void Draw() override;
+};
@@ -8,6 +8,7 @@
 #include "simulation/Air.h"
 #include "simulation/gravity/Gravity.h"
 #include <cmath>
+#include <optional>
 
 constexpr auto VIDXRES = WINDOWW;
 // constexpr auto VIDYRES = WINDOWH; // not actually used anywhere
@@ -280,7 +281,15 @@ void Renderer::render_parts()
 				}
 				else if(!(colour_mode & COLOUR_BASC))
 				{
-					if (!elements[t].Graphics || (*(elements[t].Graphics))(this, &(sim->parts[i]), nx, ny, &pixel_mode, &cola, &colr, &colg, &colb, &firea, &firer, &fireg, &fireb)) //That's a lot of args, a struct might be better
+					int cacheable = 1;
+					if (elements[t].Graphics)
+					{
+						std::optional<SimulationProfiler::ElementScope> scope;
+						if (sim->profiler.GetElementTiming())
+							scope.emplace(sim->profiler, t, SimulationProfiler::functionGraphics);
+						cacheable = (*(elements[t].Graphics))(this, &(sim->parts[i]), nx, ny, &pixel_mode, &cola, &colr, &colg, &colb, &firea, &firer, &fireg, &fireb); //That's a lot of args, a struct might be better
+					}
+					if (cacheable)
 					{
 						graphicscache[t].isready = 1;
 						graphicscache[t].pixel_mode = pixel_mode;
@@ -22,8 +22,10 @@
 #include "debug/DebugInfo.h"
 #include "debug/DebugLines.h"
 #include "debug/DebugParts.h"
+#include "debug/ElementCosts.h"
 #include "debug/ElementPopulation.h"
 #include "debug/ParticleDebug.h"
+#include "debug/SimulationProfile.h"
 #include "graphics/Renderer.h"
 #include "simulation/Air.h"
 #include "simulation/ElementClasses.h"
@@ -99,6 +101,8 @@ GameController::GameController():
 	debugInfo.push_back(new ElementPopulationDebug(0x2, gameModel->GetSimulation()));
 	debugInfo.push_back(new DebugLines(0x4, gameView, this));
 	debugInfo.push_back(new ParticleDebug(0x8, gameModel->GetSimulation(), gameModel));
+	debugInfo.push_back(new SimulationProfileDebug(0x10, gameModel->GetSimulation()));
+	debugInfo.push_back(new ElementCostsDebug(0x20, gameModel->GetSimulation()));
 }
 
 GameController::~GameController()
@@ -207,6 +211,26 @@ bool GameController::HistoryForward()
 	return true;
 }
 
+int GameController::TimeTravelBack(int ticks)
+{
+	return gameModel->TimeTravelBack(ticks);
+}
+
+int GameController::TimeTravelForward(int ticks)
+{
+	return gameModel->TimeTravelForward(ticks);
+}
+
+unsigned int GameController::GetTimeTravelBudget()
+{
+	return gameModel->GetTimeTravelBudget();
+}
+
+void GameController::SetTimeTravelBudget(unsigned int timeTravelBudget)
+{
+	gameModel->SetTimeTravelBudget(timeTravelBudget);
+}
+
 GameView * GameController::GetView()
 {
 	return gameView;
@@ -1012,6 +1036,18 @@ int GameController::GetTemperatureScale()
 	return gameModel->GetTemperatureScale();
 }
 
+void GameController::SetDebugFlags(unsigned int flags)
+{
+	for (auto *info : debugInfo)
+	{
+		bool wasEnabled = info->debugID & debugFlags;
+		bool enabled = info->debugID & flags;
+		if (wasEnabled != enabled)
+			info->SetEnabled(enabled);
+	}
+	debugFlags = flags;
+}
+
 void GameController::SetActiveColourPreset(int preset)
 {
 	gameModel->SetActiveColourPreset(preset);
@@ -82,6 +82,10 @@ public:
 	bool HistoryRestore();
 	void HistorySnapshot();
 	bool HistoryForward();
+	int TimeTravelBack(int ticks);
+	int TimeTravelForward(int ticks);
+	unsigned int GetTimeTravelBudget();
+	void SetTimeTravelBudget(unsigned int timeTravelBudget);
 
 	void AdjustGridSize(int direction);
 	void InvertAirSim();
@@ -113,7 +117,7 @@ public:
 	bool GetDebugHUD();
 	void SetTemperatureScale(int temperatureScale);
 	int GetTemperatureScale();
-	void SetDebugFlags(unsigned int flags) { debugFlags = flags; }
+	void SetDebugFlags(unsigned int flags);
 	void SetActiveMenu(int menuID);
 	std::vector<Menu*> GetMenuList();
 	int GetNumMenus(bool onlyEnabled);
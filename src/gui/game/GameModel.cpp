@@ -20,6 +20,8 @@
 #include "common/platform/Platform.h"
 #include "graphics/Renderer.h"
 #include "simulation/Air.h"
+#include "simulation/DeltaCompressor.h"
+#include "simulation/TimeTravel.h"
 #include "simulation/GOLString.h"
 #include "simulation/gravity/Gravity.h"
 #include "simulation/Simulation.h"
@@ -142,10 +144,19 @@ GameModel::GameModel():
 	colourPresets.push_back(ui::Colour(0, 0, 255));
 	colourPresets.push_back(ui::Colour(0, 0, 0));
 
-	undoHistoryLimit = prefs.Get("Simulation.UndoHistoryLimit", 5U);
-	// cap due to memory usage (this is about 3.4GB of RAM)
-	if (undoHistoryLimit > 200)
-		SetUndoHistoryLimit(200);
+	// As much as the old default of 5 entries took up
+	undoHistoryBudget = prefs.Get("Simulation.UndoHistoryBudget", 5 * snapshotMiB);
+	// Simulation.UndoHistoryLimit used to be a number of entries, each of them a full Snapshot,
+	// capped at 200. Give the budget the memory that the limit would have allowed.
+	auto undoHistoryLimit = prefs.Get("Simulation.UndoHistoryLimit", -1);
+	if (undoHistoryLimit >= 0)
+	{
+		Prefs::DeferWrite dw(prefs);
+		SetUndoHistoryBudget(std::min(undoHistoryLimit, 200) * snapshotMiB);
+		prefs.Clear("Simulation.UndoHistoryLimit");
+	}
+	historyCompressor = std::make_unique<DeltaCompressor>();
+	SetTimeTravelBudget(prefs.Get("Simulation.TimeTravelBudget", 0U));
 
 	mouseClickRequired = prefs.Get("MouseClickRequired", false);
 	includePressure = prefs.Get("Simulation.IncludePressure", true);
@@ -688,8 +699,14 @@ int GameModel::GetDecoSpace()
 //            |                 |                         |           /   |
 //       ...  |      ...        |          ...            |   ...    ...  |
 //
-//   * After all this, the front of the deque is truncated such that there are on more than
-//     undoHistoryLimit entries left.
+//   * After all this, the front of the deque is truncated such that the SnapshotDeltas left take
+//     up no more than undoHistoryBudget MiB, though the newest entry is always kept. The Snapshot
+//     in history[N-1], historyCurrent and Simulation::lastSnapshot are not counted.
+// * SnapshotDeltas other than the one in history[N-2], which is the one the next HistoryRestore
+//   needs, are compressed by historyCompressor in the background, see HistoryCompressOld.
+//   Compressed SnapshotDeltas are decompressed by Forward and Restore as needed, the copy in
+//   history stays compressed. An entry must be settled with HistorySettle before its
+//   SnapshotDelta is used or destroyed.
 
 const Snapshot *GameModel::HistoryCurrent() const
 {
@@ -714,6 +731,7 @@ void GameModel::HistoryRestore()
 	}
 	else
 	{
+		HistorySettle(history[historyPosition]);
 		historyCurrent = history[historyPosition].delta->Restore(*historyCurrent);
 	}
 }
@@ -740,6 +758,7 @@ void GameModel::HistoryForward()
 	}
 	else
 	{
+		HistorySettle(history[historyPosition - 1U]);
 		historyCurrent = history[historyPosition - 1U].delta->Forward(*historyCurrent);
 	}
 }
@@ -752,40 +771,117 @@ void GameModel::HistoryPush(std::unique_ptr<Snapshot> last)
 		rebaseOnto = history.back().snap.get();
 		if (historyPosition < history.size())
 		{
+			HistorySettle(history[historyPosition - 1U]);
 			historyCurrent = history[historyPosition - 1U].delta->Restore(*historyCurrent);
 			rebaseOnto = historyCurrent.get();
 		}
 	}
 	while (historyPosition < history.size())
 	{
+		HistorySettle(history.back());
 		history.pop_back();
 	}
 	if (rebaseOnto)
 	{
 		auto &prev = history.back();
-		prev.delta = SnapshotDelta::FromSnapshots(*rebaseOnto, *last);
+		HistorySettle(prev);
+		prev.delta = SnapshotDelta::FromSnapshots(*rebaseOnto, *last, sim->GetUpdatePool());
+		prev.compressing = false;
 		prev.snap.reset();
 	}
 	history.emplace_back();
 	history.back().snap = std::move(last);
 	historyPosition += 1U;
 	historyCurrent.reset();
-	while (undoHistoryLimit < history.size())
+	HistoryCompressOld();
+
+	size_t budget = size_t(undoHistoryBudget) << 20;
+	size_t bytes = 0;
+	for (auto &entry : history)
+	{
+		bytes += entry.delta ? entry.delta->Bytes() : 0U;
+	}
+	if (bytes > budget)
 	{
+		// Deltas that are still being compressed count as their uncompressed size, give them a chance to shrink first
+		historyCompressor->Wait();
+		bytes = 0;
+		for (auto &entry : history)
+		{
+			bytes += entry.delta ? entry.delta->Bytes() : 0U;
+		}
+	}
+	while (history.size() > 1U && bytes > budget)
+	{
+		HistorySettle(history.front());
+		bytes -= history.front().delta ? history.front().delta->Bytes() : 0U;
 		history.pop_front();
 		historyPosition -= 1U;
 	}
 }
 
-unsigned int GameModel::GetUndoHistoryLimit()
+void GameModel::HistorySettle(HistoryEntry &entry)
+{
+	if (entry.compressing && historyCompressor->Settle(entry.delta.get()))
+	{
+		entry.compressing = false;
+	}
+}
+
+void GameModel::HistoryCompressOld()
+{
+	for (auto i = 0U; i + 2U < history.size(); ++i)
+	{
+		auto &entry = history[i];
+		if (entry.delta && !entry.compressing)
+		{
+			entry.compressing = true;
+			historyCompressor->Push(entry.delta.get());
+		}
+	}
+}
+
+unsigned int GameModel::GetUndoHistoryBudget()
 {
-	return undoHistoryLimit;
+	return undoHistoryBudget;
 }
 
-void GameModel::SetUndoHistoryLimit(unsigned int undoHistoryLimit_)
+void GameModel::SetUndoHistoryBudget(unsigned int undoHistoryBudget_)
 {
-	undoHistoryLimit = undoHistoryLimit_;
-	GlobalPrefs::Ref().Set("Simulation.UndoHistoryLimit", undoHistoryLimit);
+	undoHistoryBudget = undoHistoryBudget_;
+	GlobalPrefs::Ref().Set("Simulation.UndoHistoryBudget", undoHistoryBudget);
+}
+
+unsigned int GameModel::GetTimeTravelBudget()
+{
+	return timeTravel ? (unsigned int)(timeTravel->GetBudget() >> 20) : 0U;
+}
+
+void GameModel::SetTimeTravelBudget(unsigned int timeTravelBudget)
+{
+	if (!timeTravelBudget)
+	{
+		timeTravel.reset();
+	}
+	else if (timeTravel)
+	{
+		timeTravel->SetBudget(size_t(timeTravelBudget) << 20);
+	}
+	else
+	{
+		timeTravel = std::make_unique<TimeTravel>(size_t(timeTravelBudget) << 20);
+	}
+	GlobalPrefs::Ref().Set("Simulation.TimeTravelBudget", timeTravelBudget);
+}
+
+int GameModel::TimeTravelBack(int ticks)
+{
+	return timeTravel ? timeTravel->Back(*sim, ticks) : 0;
+}
+
+int GameModel::TimeTravelForward(int ticks)
+{
+	return timeTravel ? timeTravel->Forward(*sim, ticks) : 0;
 }
 
 void GameModel::SetVote(int direction)
@@ -1689,7 +1785,8 @@ void GameModel::UpdateUpTo(int upTo)
 
 void GameModel::BeforeSim()
 {
-	if (!sim->sys_pause || sim->framerender)
+	simAdvancing = !sim->sys_pause || sim->framerender;
+	if (simAdvancing)
 	{
 		commandInterface->HandleEvent(BeforeSimEvent{});
 	}
@@ -1700,4 +1797,8 @@ void GameModel::AfterSim()
 {
 	sim->AfterSim();
 	commandInterface->HandleEvent(AfterSimEvent{});
+	if (simAdvancing && timeTravel)
+	{
+		timeTravel->Record(*sim);
+	}
 }
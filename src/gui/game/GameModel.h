@@ -19,6 +19,8 @@ class Simulation;
 class Renderer;
 class Snapshot;
 struct SnapshotDelta;
+class DeltaCompressor;
+class TimeTravel;
 class GameSave;
 
 class ToolSelection
@@ -34,6 +36,8 @@ struct HistoryEntry
 {
 	std::unique_ptr<Snapshot> snap;
 	std::unique_ptr<SnapshotDelta> delta;
+	// delta has been handed to GameModel::historyCompressor, see GameModel::HistoryCompressOld.
+	bool compressing = false;
 
 	~HistoryEntry();
 };
@@ -73,7 +77,17 @@ private:
 	std::deque<HistoryEntry> history;
 	std::unique_ptr<Snapshot> historyCurrent;
 	unsigned int historyPosition;
-	unsigned int undoHistoryLimit;
+	// Simulation.UndoHistoryBudget, in MiB, see HistoryPush. Only the SnapshotDeltas in history
+	// count towards it; the Snapshot of the newest entry, historyCurrent and
+	// Simulation::lastSnapshot can each take up to a full Snapshot on top of that.
+	unsigned int undoHistoryBudget;
+	// About how many MiB a full Snapshot takes up, which is what each entry of history used to
+	// cost when they were all full Snapshots, see the Simulation.UndoHistoryLimit migration.
+	static constexpr unsigned int snapshotMiB = 17;
+	// Declared after history so it's stopped before history is destroyed.
+	std::unique_ptr<DeltaCompressor> historyCompressor;
+	std::unique_ptr<TimeTravel> timeTravel; // null if disabled
+	bool simAdvancing = false; // set by BeforeSim if the frame being updated is simulated
 	bool mouseClickRequired;
 	bool includePressure;
 	bool perfectCircle = true;
@@ -153,14 +167,22 @@ public:
 	void BuildBrushList();
 	void BuildQuickOptionMenu(GameController * controller);
 
+	void HistorySettle(HistoryEntry &entry);
+	void HistoryCompressOld();
+
 	const Snapshot *HistoryCurrent() const;
 	bool HistoryCanRestore() const;
 	void HistoryRestore();
 	bool HistoryCanForward() const;
 	void HistoryForward();
 	void HistoryPush(std::unique_ptr<Snapshot> last);
-	unsigned int GetUndoHistoryLimit();
-	void SetUndoHistoryLimit(unsigned int undoHistoryLimit_);
+	unsigned int GetUndoHistoryBudget();
+	void SetUndoHistoryBudget(unsigned int undoHistoryBudget_);
+	// In MiB, 0 disables time travel, see TimeTravel.
+	unsigned int GetTimeTravelBudget();
+	void SetTimeTravelBudget(unsigned int timeTravelBudget);
+	int TimeTravelBack(int ticks);
+	int TimeTravelForward(int ticks);
 
 	void UpdateQuickOptions();
 
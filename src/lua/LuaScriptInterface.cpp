@@ -35,6 +35,7 @@
 #include "simulation/Simulation.h"
 #include "simulation/ToolClasses.h"
 #include "simulation/SaveRenderer.h"
+#include "simulation/gravity/Gravity.h"
 
 #include "gui/interface/Window.h"
 #include "gui/interface/Engine.h"
@@ -945,6 +946,19 @@ void LuaScriptInterface::initSimulationAPI()
 		{"lastUpdatedID", simulation_lastUpdatedID},
 		{"updateUpTo", simulation_updateUpTo},
 		{"temperatureScale", simulation_temperatureScale},
+		{"profile", simulation_profile},
+		{"elementProfiling", simulation_elementProfiling},
+		{"elementProfile", simulation_elementProfile},
+		{"updateThreads", simulation_updateThreads},
+		{"sleepingRegions", simulation_sleepingRegions},
+		{"compactParticles", simulation_compactParticles},
+		{"compactInterval", simulation_compactInterval},
+		{"pipelinedAir", simulation_pipelinedAir},
+		{"heatGrid", simulation_heatGrid},
+		{"timeTravelBudget", simulation_timeTravelBudget},
+		{"timeTravelBack", simulation_timeTravelBack},
+		{"timeTravelForward", simulation_timeTravelForward},
+		{"gravityIncrementalThreshold", simulation_gravityIncrementalThreshold},
 		{NULL, NULL}
 	};
 	luaL_register(l, "simulation", simulationAPIMethods);
@@ -2127,7 +2141,19 @@ int LuaScriptInterface::simulation_elementCount(lua_State * l)
 	if (element < 0 || element >= PT_NUM)
 		return luaL_error(l, "Invalid element ID (%d)", element);
 
-	lua_pushnumber(l, luacon_sim->elementCount[element]);
+	if (!element)
+	{
+		lua_pushnumber(l, luacon_sim->elementCount[element]);
+		return 1;
+	}
+	// elementCount can drift between recounts, the type index is rebuilt every frame
+	int count = 0;
+	for (auto i : luacon_sim->typeIndex.Get(element))
+	{
+		if (luacon_sim->parts[i].type == element)
+			count++;
+	}
+	lua_pushnumber(l, count);
 	return 1;
 }
 
@@ -2503,6 +2529,177 @@ int LuaScriptInterface::simulation_temperatureScale(lua_State *l)
 	return 0;
 }
 
+static void pushPhaseTime(lua_State *l, const SimulationProfiler::PhaseTime &time)
+{
+	lua_newtable(l);
+	lua_pushnumber(l, time.average);
+	lua_setfield(l, -2, "average");
+	lua_pushnumber(l, time.last);
+	lua_setfield(l, -2, "last");
+}
+
+int LuaScriptInterface::simulation_profile(lua_State *l)
+{
+	auto &profiler = luacon_sim->profiler;
+	lua_newtable(l);
+	for (int i = 0; i < SimulationProfiler::phaseCount; i++)
+	{
+		auto phase = SimulationProfiler::Phase(i);
+		pushPhaseTime(l, profiler.GetTime(phase));
+		lua_setfield(l, -2, SimulationProfiler::PhaseName(phase));
+	}
+	pushPhaseTime(l, profiler.GetFrameTime());
+	lua_setfield(l, -2, "frame");
+	return 1;
+}
+
+int LuaScriptInterface::simulation_elementProfiling(lua_State *l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushboolean(l, luacon_sim->profiler.GetElementTiming());
+		return 1;
+	}
+	luaL_checktype(l, 1, LUA_TBOOLEAN);
+	luacon_sim->profiler.SetElementTiming(lua_toboolean(l, 1));
+	return 0;
+}
+
+int LuaScriptInterface::simulation_elementProfile(lua_State *l)
+{
+	auto &profiler = luacon_sim->profiler;
+	lua_newtable(l);
+	for (int t = 1; t < PT_NUM; t++)
+	{
+		auto &cost = profiler.GetElementCost(t);
+		if (!luacon_sim->elements[t].Enabled || (!cost.calls[SimulationProfiler::functionUpdate] && !cost.calls[SimulationProfiler::functionGraphics]))
+			continue;
+		lua_newtable(l);
+		lua_pushnumber(l, cost.time[SimulationProfiler::functionUpdate]);
+		lua_setfield(l, -2, "updateTime");
+		lua_pushnumber(l, cost.calls[SimulationProfiler::functionUpdate]);
+		lua_setfield(l, -2, "updateCalls");
+		lua_pushnumber(l, cost.time[SimulationProfiler::functionGraphics]);
+		lua_setfield(l, -2, "graphicsTime");
+		lua_pushnumber(l, cost.calls[SimulationProfiler::functionGraphics]);
+		lua_setfield(l, -2, "graphicsCalls");
+		lua_rawseti(l, -2, t);
+	}
+	return 1;
+}
+
+int LuaScriptInterface::simulation_updateThreads(lua_State *l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushinteger(l, luacon_sim->GetUpdateThreads());
+		return 1;
+	}
+	int updateThreads = luaL_checkinteger(l, 1);
+	if (updateThreads < 1 || updateThreads > 64)
+		return luaL_error(l, "Invalid thread count");
+	luacon_sim->SetUpdateThreads(updateThreads);
+	return 0;
+}
+
+int LuaScriptInterface::simulation_sleepingRegions(lua_State *l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushboolean(l, luacon_sim->GetSleepingRegions());
+		return 1;
+	}
+	luaL_checktype(l, 1, LUA_TBOOLEAN);
+	luacon_sim->SetSleepingRegions(lua_toboolean(l, 1));
+	return 0;
+}
+
+int LuaScriptInterface::simulation_compactParticles(lua_State *l)
+{
+	luacon_sim->CompactParticles();
+	return 0;
+}
+
+int LuaScriptInterface::simulation_compactInterval(lua_State *l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushinteger(l, luacon_sim->GetCompactInterval());
+		return 1;
+	}
+	int compactInterval = luaL_checkinteger(l, 1);
+	if (compactInterval < 0)
+		return luaL_error(l, "Invalid interval");
+	luacon_sim->SetCompactInterval(compactInterval);
+	return 0;
+}
+
+int LuaScriptInterface::simulation_pipelinedAir(lua_State *l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushboolean(l, luacon_sim->air->IsPipelined());
+		return 1;
+	}
+	luaL_checktype(l, 1, LUA_TBOOLEAN);
+	luacon_sim->air->SetPipelined(lua_toboolean(l, 1));
+	return 0;
+}
+
+int LuaScriptInterface::simulation_heatGrid(lua_State *l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushboolean(l, luacon_sim->GetHeatGrid());
+		return 1;
+	}
+	luaL_checktype(l, 1, LUA_TBOOLEAN);
+	luacon_sim->SetHeatGrid(lua_toboolean(l, 1));
+	return 0;
+}
+
+int LuaScriptInterface::simulation_timeTravelBudget(lua_State *l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushinteger(l, luacon_controller->GetTimeTravelBudget());
+		return 1;
+	}
+	int budget = luaL_checkinteger(l, 1);
+	if (budget < 0)
+		return luaL_error(l, "Invalid budget");
+	luacon_controller->SetTimeTravelBudget(budget);
+	return 0;
+}
+
+int LuaScriptInterface::simulation_timeTravelBack(lua_State *l)
+{
+	int ticks = luaL_optint(l, 1, 1);
+	lua_pushinteger(l, luacon_controller->TimeTravelBack(ticks));
+	return 1;
+}
+
+int LuaScriptInterface::simulation_timeTravelForward(lua_State *l)
+{
+	int ticks = luaL_optint(l, 1, 1);
+	lua_pushinteger(l, luacon_controller->TimeTravelForward(ticks));
+	return 1;
+}
+
+int LuaScriptInterface::simulation_gravityIncrementalThreshold(lua_State *l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushinteger(l, luacon_sim->grav->GetIncrementalThreshold());
+		return 1;
+	}
+	int threshold = luaL_checkinteger(l, 1);
+	if (threshold < 0)
+		return luaL_error(l, "Invalid threshold");
+	luacon_sim->grav->SetIncrementalThreshold(threshold);
+	return 0;
+}
+
 //// Begin Renderer API
 
 void LuaScriptInterface::initRendererAPI()
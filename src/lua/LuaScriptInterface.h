@@ -105,6 +105,19 @@ class LuaScriptInterface: public TPTScriptInterface
 	static int simulation_lastUpdatedID(lua_State *l);
 	static int simulation_updateUpTo(lua_State *l);
 	static int simulation_temperatureScale(lua_State *l);
+	static int simulation_profile(lua_State *l);
+	static int simulation_elementProfiling(lua_State *l);
+	static int simulation_elementProfile(lua_State *l);
+	static int simulation_updateThreads(lua_State *l);
+	static int simulation_sleepingRegions(lua_State *l);
+	static int simulation_compactParticles(lua_State *l);
+	static int simulation_compactInterval(lua_State *l);
+	static int simulation_pipelinedAir(lua_State *l);
+	static int simulation_heatGrid(lua_State *l);
+	static int simulation_timeTravelBudget(lua_State *l);
+	static int simulation_timeTravelBack(lua_State *l);
+	static int simulation_timeTravelForward(lua_State *l);
+	static int simulation_gravityIncrementalThreshold(lua_State *l);
 
 
 	//Renderer
@@ -562,6 +562,7 @@ AnyType TPTScriptInterface::tptS_reset(std::deque<String> * words)
 			{
 				sim->air->pv[ny][nx] = 0;
 			}
+		sim->air->DiscardPipelined();
 	}
 	else if (resetStr == "velocity")
 	{
@@ -571,6 +572,7 @@ AnyType TPTScriptInterface::tptS_reset(std::deque<String> * words)
 				sim->air->vx[ny][nx] = 0;
 				sim->air->vy[ny][nx] = 0;
 			}
+		sim->air->DiscardPipelined();
 	}
 	else if (resetStr == "sparks")
 	{
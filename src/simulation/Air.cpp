@@ -2,8 +2,13 @@
 #include "Simulation.h"
 #include "ElementClasses.h"
 #include "common/tpt-rand.h"
+#include "common/WorkerPool.h"
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 /*float kernel[9];
 
@@ -37,19 +42,109 @@ void Air::make_kernel(void) //used for velocity
 			kernel[(i+1)+3*(j+1)] *= s;
 }
 
+// State of the air thread, see Air::SetPipelined. The th_ maps and th_air belong to the
+// thread while a job is running, everything else is only touched by the main thread.
+struct AirPipeline
+{
+	std::unique_ptr<Air> th_air; // the maps that the thread updates
+	unsigned char th_bmap[YCELLS][XCELLS];
+	float th_fvx[YCELLS][XCELLS];
+	float th_fvy[YCELLS][XCELLS];
+	bool th_heat = false;
+
+	// The maps as they were when the running job was started, so that the changes
+	// particles have made since can be told apart when the result is collected.
+	float sentVx[YCELLS][XCELLS];
+	float sentVy[YCELLS][XCELLS];
+	float sentPv[YCELLS][XCELLS];
+	float sentHv[YCELLS][XCELLS];
+
+	bool running = false; // a job was started and hasn't been collected yet
+	bool ignoreAir = false; // the maps were cleared or replaced while the job was running
+	bool ignoreHeat = false;
+
+	std::thread airthread;
+	std::mutex airmutex;
+	std::condition_variable aircv;
+	bool work = false;
+	bool airthread_done = false;
+
+	AirPipeline(Simulation &sim) : th_air(std::make_unique<Air>(sim))
+	{
+		th_air->bmap = th_bmap;
+		th_air->emap = nullptr;
+		th_air->fvx = th_fvx;
+		th_air->fvy = th_fvy;
+	}
+};
+
 void Air::Clear()
 {
 	std::fill(&pv[0][0], &pv[0][0]+NCELL, 0.0f);
 	std::fill(&vy[0][0], &vy[0][0]+NCELL, 0.0f);
 	std::fill(&vx[0][0], &vx[0][0]+NCELL, 0.0f);
+	if (pipeline && pipeline->running)
+		pipeline->ignoreAir = true;
 }
 
 void Air::ClearAirH()
 {
 	std::fill(&hv[0][0], &hv[0][0]+NCELL, ambientAirTemp);
+	if (pipeline && pipeline->running)
+		pipeline->ignoreHeat = true;
+}
+
+// Picks a if mask is all ones and b if it is all zeros. Written with bit operations because
+// the compiler only vectorises a float ternary with SSE4.1 and up.
+static inline float Select(uint32_t mask, float a, float b)
+{
+	uint32_t bitsA, bitsB;
+	std::memcpy(&bitsA, &a, sizeof(bitsA));
+	std::memcpy(&bitsB, &b, sizeof(bitsB));
+	uint32_t bits = (bitsA & mask) | (bitsB & ~mask);
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+static inline uint32_t Mask(bool value)
+{
+	return value ? UINT32_C(0xFFFFFFFF) : 0U;
+}
+
+void Air::ForEachRow(int begin, int end, const std::function<void (int)> &row)
+{
+	if (workerPool)
+	{
+		workerPool->ParallelFor(end - begin, [begin, &row](int i) {
+			row(begin + i);
+		});
+		return;
+	}
+	for (int y = begin; y < end; y++)
+	{
+		row(y);
+	}
+}
+
+void Air::SampleGravity()
+{
+	for (int y=2; y<YCELLS-2; y++)
+	{
+		for (int x=2; x<XCELLS-2; x++)
+		{
+			sim.GetGravityField(x*CELL, y*CELL, -1.0f, -1.0f, cellGravX[y][x], cellGravY[y][x]);
+		}
+	}
 }
 
 void Air::update_airh(void)
+{
+	SampleGravity();
+	UpdateAirHeat();
+}
+
+void Air::UpdateAirHeat()
 {
 	int x, y, i, j;
 	float odh, dh, dx, dy, f, tx, ty;
@@ -116,8 +211,7 @@ void Air::update_airh(void)
 			ohv[y][x] = dh;
 			if (x>=2 && x<XCELLS-2 && y>=2 && y<YCELLS-2)
 			{
-				float convGravX, convGravY;
-				sim.GetGravityField(x*CELL, y*CELL, -1.0f, -1.0f, convGravX, convGravY);
+				float convGravX = cellGravX[y][x], convGravY = cellGravY[y][x];
 				auto weight = ((hv[y][x] - hv[y][x-1]) * convGravX + (hv[y][x] - hv[y-1][x]) * convGravY) / 5000.0f;
 				if (weight > 0 && !(bmap_blockairh[y-1][x]&0x8))
 				{
@@ -133,10 +227,6 @@ void Air::update_airh(void)
 void Air::update_air(void)
 {
 	int x = 0, y = 0, i = 0, j = 0;
-	float dp = 0.0f, dx = 0.0f, dy = 0.0f, f = 0.0f, tx = 0.0f, ty = 0.0f;
-	const float advDistanceMult = 0.7f;
-	float stepX, stepY;
-	int stepLimit, step;
 
 	if (airMode != 4) { //airMode 4 is no air/pressure update
 
@@ -173,6 +263,19 @@ void Air::update_air(void)
 			vy[YCELLS-1][i] = vy[YCELLS-1][i]*0.9f;
 		}
 
+		// In the passes after the wall clearing each row only writes to itself, so rows can go to
+		// different threads, and walls are looked up in the masks below rather than branched on,
+		// so the compiler can vectorise the rows. Each cell still does the same arithmetic.
+
+		for (y=0; y<YCELLS; y++)
+		{
+			for (x=0; x<XCELLS; x++)
+			{
+				airBlocked[y][x] = Mask(bmap_blockair[y][x]);
+				airOpen[y][x] = Mask(y>0 && y<YCELLS-1 && x>0 && x<XCELLS-1 && !bmap_blockair[y][x]);
+			}
+		}
+
 		for (j=1; j<YCELLS; j++) //clear some velocities near walls
 		{
 			for (i=1; i<XCELLS; i++)
@@ -187,159 +290,201 @@ void Air::update_air(void)
 			}
 		}
 
-		for (y=1; y<YCELLS; y++) //pressure adjustments from velocity
-			for (x=1; x<XCELLS; x++)
+		ForEachRow(1, YCELLS, [this](int y) { //pressure adjustments from velocity
+			for (int x=1; x<XCELLS; x++)
 			{
-				dp = 0.0f;
+				float dp = 0.0f;
 				dp += vx[y][x-1] - vx[y][x];
 				dp += vy[y-1][x] - vy[y][x];
 				pv[y][x] *= AIR_PLOSS;
 				pv[y][x] += dp*AIR_TSTEPP;
 			}
+		});
 
-		for (y=0; y<YCELLS-1; y++) //velocity adjustments from pressure
-			for (x=0; x<XCELLS-1; x++)
+		ForEachRow(0, YCELLS-1, [this](int y) { //velocity adjustments from pressure
+			for (int x=0; x<XCELLS-1; x++)
 			{
-				dx = dy = 0.0f;
+				float dx = 0.0f, dy = 0.0f;
 				dx += pv[y][x] - pv[y][x+1];
 				dy += pv[y][x] - pv[y+1][x];
 				vx[y][x] *= AIR_VLOSS;
 				vy[y][x] *= AIR_VLOSS;
 				vx[y][x] += dx*AIR_TSTEPV;
 				vy[y][x] += dy*AIR_TSTEPV;
-				if (bmap_blockair[y][x] || bmap_blockair[y][x+1])
-					vx[y][x] = 0;
-				if (bmap_blockair[y][x] || bmap_blockair[y+1][x])
-					vy[y][x] = 0;
+				vx[y][x] = Select(airBlocked[y][x] | airBlocked[y][x+1], 0.0f, vx[y][x]);
+				vy[y][x] = Select(airBlocked[y][x] | airBlocked[y+1][x], 0.0f, vy[y][x]);
 			}
+		});
 
-		for (y=0; y<YCELLS; y++) //update velocity and pressure
-			for (x=0; x<XCELLS; x++)
-			{
-				dx = 0.0f;
-				dy = 0.0f;
-				dp = 0.0f;
-				for (j=-1; j<2; j++)
-					for (i=-1; i<2; i++)
-						if (y+j>0 && y+j<YCELLS-1 &&
-						        x+i>0 && x+i<XCELLS-1 &&
-						        !bmap_blockair[y+j][x+i])
-						{
-							f = kernel[i+1+(j+1)*3];
-							dx += vx[y+j][x+i]*f;
-							dy += vy[y+j][x+i]*f;
-							dp += pv[y+j][x+i]*f;
-						}
-						else
-						{
-							f = kernel[i+1+(j+1)*3];
-							dx += vx[y][x]*f;
-							dy += vy[y][x]*f;
-							dp += pv[y][x]*f;
-						}
+		ForEachRow(0, YCELLS, [this](int y) { //update velocity and pressure
+			UpdateAirRow(y);
+		});
+		memcpy(vx, ovx, sizeof(vx));
+		memcpy(vy, ovy, sizeof(vy));
+		memcpy(pv, opv, sizeof(pv));
+	}
+}
 
-				tx = x - dx*advDistanceMult;
-				ty = y - dy*advDistanceMult;
-				if ((dx*advDistanceMult>1.0f || dy*advDistanceMult>1.0f) && (tx>=2 && tx<XCELLS-2 && ty>=2 && ty<YCELLS-2))
+void Air::UpdateAirRow(int y)
+{
+	int x, i, j;
+	float dp, dx, dy, f, tx, ty;
+	const float advDistanceMult = 0.7f;
+	float stepX, stepY;
+	int stepLimit, step;
+
+	// Blur of the interior cells of the row, all neighbours are within the arrays there
+	float dxRow[XCELLS], dyRow[XCELLS], dpRow[XCELLS];
+	if (y>0 && y<YCELLS-1)
+	{
+		std::fill(dxRow+1, dxRow+XCELLS-1, 0.0f);
+		std::fill(dyRow+1, dyRow+XCELLS-1, 0.0f);
+		std::fill(dpRow+1, dpRow+XCELLS-1, 0.0f);
+		for (j=-1; j<2; j++)
+		{
+			for (i=-1; i<2; i++)
+			{
+				f = kernel[i+1+(j+1)*3];
+				for (x=1; x<XCELLS-1; x++)
 				{
-					// Trying to take velocity from far away, check whether there is an intervening wall. Step from current position to desired source location, looking for walls, with either the x or y step size being 1 cell
-					if (std::abs(dx)>std::abs(dy))
+					auto open = airOpen[y+j][x+i];
+					dxRow[x] += Select(open, vx[y+j][x+i], vx[y][x])*f;
+					dyRow[x] += Select(open, vy[y+j][x+i], vy[y][x])*f;
+					dpRow[x] += Select(open, pv[y+j][x+i], pv[y][x])*f;
+				}
+			}
+		}
+	}
+
+	for (x=0; x<XCELLS; x++)
+	{
+		if (y>0 && y<YCELLS-1 && x>0 && x<XCELLS-1)
+		{
+			dx = dxRow[x];
+			dy = dyRow[x];
+			dp = dpRow[x];
+		}
+		else
+		{
+			dx = 0.0f;
+			dy = 0.0f;
+			dp = 0.0f;
+			for (j=-1; j<2; j++)
+				for (i=-1; i<2; i++)
+					if (y+j>=0 && y+j<YCELLS && x+i>=0 && x+i<XCELLS && airOpen[y+j][x+i])
 					{
-						stepX = (dx<0.0f) ? 1.f : -1.f;
-						stepY = -dy/fabsf(dx);
-						stepLimit = (int)(fabsf(dx*advDistanceMult));
+						f = kernel[i+1+(j+1)*3];
+						dx += vx[y+j][x+i]*f;
+						dy += vy[y+j][x+i]*f;
+						dp += pv[y+j][x+i]*f;
 					}
 					else
 					{
-						stepY = (dy<0.0f) ? 1.f : -1.f;
-						stepX = -dx/fabsf(dy);
-						stepLimit = (int)(fabsf(dy*advDistanceMult));
-					}
-					tx = float(x);
-					ty = float(y);
-					for (step=0; step<stepLimit; ++step)
-					{
-						tx += stepX;
-						ty += stepY;
-						if (bmap_blockair[(int)(ty+0.5f)][(int)(tx+0.5f)])
-						{
-							tx -= stepX;
-							ty -= stepY;
-							break;
-						}
-					}
-					if (step==stepLimit)
-					{
-						// No wall found
-						tx = x - dx*advDistanceMult;
-						ty = y - dy*advDistanceMult;
+						f = kernel[i+1+(j+1)*3];
+						dx += vx[y][x]*f;
+						dy += vy[y][x]*f;
+						dp += pv[y][x]*f;
 					}
-				}
-				i = (int)tx;
-				j = (int)ty;
-				tx -= i;
-				ty -= j;
-				if (!bmap_blockair[y][x] && i>=2 && i<=XCELLS-3 &&
-				        j>=2 && j<=YCELLS-3)
+		}
+
+		tx = x - dx*advDistanceMult;
+		ty = y - dy*advDistanceMult;
+		if ((dx*advDistanceMult>1.0f || dy*advDistanceMult>1.0f) && (tx>=2 && tx<XCELLS-2 && ty>=2 && ty<YCELLS-2))
+		{
+			// Trying to take velocity from far away, check whether there is an intervening wall. Step from current position to desired source location, looking for walls, with either the x or y step size being 1 cell
+			if (std::abs(dx)>std::abs(dy))
+			{
+				stepX = (dx<0.0f) ? 1.f : -1.f;
+				stepY = -dy/fabsf(dx);
+				stepLimit = (int)(fabsf(dx*advDistanceMult));
+			}
+			else
+			{
+				stepY = (dy<0.0f) ? 1.f : -1.f;
+				stepX = -dx/fabsf(dy);
+				stepLimit = (int)(fabsf(dy*advDistanceMult));
+			}
+			tx = float(x);
+			ty = float(y);
+			for (step=0; step<stepLimit; ++step)
+			{
+				tx += stepX;
+				ty += stepY;
+				if (bmap_blockair[(int)(ty+0.5f)][(int)(tx+0.5f)])
 				{
-					dx *= 1.0f - AIR_VADV;
-					dy *= 1.0f - AIR_VADV;
+					tx -= stepX;
+					ty -= stepY;
+					break;
+				}
+			}
+			if (step==stepLimit)
+			{
+				// No wall found
+				tx = x - dx*advDistanceMult;
+				ty = y - dy*advDistanceMult;
+			}
+		}
+		i = (int)tx;
+		j = (int)ty;
+		tx -= i;
+		ty -= j;
+		if (!bmap_blockair[y][x] && i>=2 && i<=XCELLS-3 &&
+		        j>=2 && j<=YCELLS-3)
+		{
+			dx *= 1.0f - AIR_VADV;
+			dy *= 1.0f - AIR_VADV;
 
-					dx += AIR_VADV*(1.0f-tx)*(1.0f-ty)*vx[j][i];
-					dy += AIR_VADV*(1.0f-tx)*(1.0f-ty)*vy[j][i];
+			dx += AIR_VADV*(1.0f-tx)*(1.0f-ty)*vx[j][i];
+			dy += AIR_VADV*(1.0f-tx)*(1.0f-ty)*vy[j][i];
 
-					dx += AIR_VADV*tx*(1.0f-ty)*vx[j][i+1];
-					dy += AIR_VADV*tx*(1.0f-ty)*vy[j][i+1];
+			dx += AIR_VADV*tx*(1.0f-ty)*vx[j][i+1];
+			dy += AIR_VADV*tx*(1.0f-ty)*vy[j][i+1];
 
-					dx += AIR_VADV*(1.0f-tx)*ty*vx[j+1][i];
-					dy += AIR_VADV*(1.0f-tx)*ty*vy[j+1][i];
+			dx += AIR_VADV*(1.0f-tx)*ty*vx[j+1][i];
+			dy += AIR_VADV*(1.0f-tx)*ty*vy[j+1][i];
 
-					dx += AIR_VADV*tx*ty*vx[j+1][i+1];
-					dy += AIR_VADV*tx*ty*vy[j+1][i+1];
-				}
+			dx += AIR_VADV*tx*ty*vx[j+1][i+1];
+			dy += AIR_VADV*tx*ty*vy[j+1][i+1];
+		}
 
-				if (bmap[y][x] == WL_FAN)
-				{
-					dx += fvx[y][x];
-					dy += fvy[y][x];
-				}
-				// pressure/velocity caps
-				if (dp > MAX_PRESSURE) dp = MAX_PRESSURE;
-				if (dp < MIN_PRESSURE) dp = MIN_PRESSURE;
-				if (dx > MAX_PRESSURE) dx = MAX_PRESSURE;
-				if (dx < MIN_PRESSURE) dx = MIN_PRESSURE;
-				if (dy > MAX_PRESSURE) dy = MAX_PRESSURE;
-				if (dy < MIN_PRESSURE) dy = MIN_PRESSURE;
+		if (bmap[y][x] == WL_FAN)
+		{
+			dx += fvx[y][x];
+			dy += fvy[y][x];
+		}
+		// pressure/velocity caps
+		if (dp > MAX_PRESSURE) dp = MAX_PRESSURE;
+		if (dp < MIN_PRESSURE) dp = MIN_PRESSURE;
+		if (dx > MAX_PRESSURE) dx = MAX_PRESSURE;
+		if (dx < MIN_PRESSURE) dx = MIN_PRESSURE;
+		if (dy > MAX_PRESSURE) dy = MAX_PRESSURE;
+		if (dy < MIN_PRESSURE) dy = MIN_PRESSURE;
 
 
-				switch (airMode)
-				{
-				default:
-				case 0:  //Default
-					break;
-				case 1:  //0 Pressure
-					dp = 0.0f;
-					break;
-				case 2:  //0 Velocity
-					dx = 0.0f;
-					dy = 0.0f;
-					break;
-				case 3: //0 Air
-					dx = 0.0f;
-					dy = 0.0f;
-					dp = 0.0f;
-					break;
-				case 4: //No Update
-					break;
-				}
+		switch (airMode)
+		{
+		default:
+		case 0:  //Default
+			break;
+		case 1:  //0 Pressure
+			dp = 0.0f;
+			break;
+		case 2:  //0 Velocity
+			dx = 0.0f;
+			dy = 0.0f;
+			break;
+		case 3: //0 Air
+			dx = 0.0f;
+			dy = 0.0f;
+			dp = 0.0f;
+			break;
+		case 4: //No Update
+			break;
+		}
 
-				ovx[y][x] = dx;
-				ovy[y][x] = dy;
-				opv[y][x] = dp;
-			}
-		memcpy(vx, ovx, sizeof(vx));
-		memcpy(vy, ovy, sizeof(vy));
-		memcpy(pv, opv, sizeof(pv));
+		ovx[y][x] = dx;
+		ovy[y][x] = dy;
+		opv[y][x] = dp;
 	}
 }
 
@@ -353,6 +498,8 @@ void Air::Invert()
 			vx[ny][nx] = -vx[ny][nx];
 			vy[ny][nx] = -vy[ny][nx];
 		}
+	if (pipeline && pipeline->running)
+		pipeline->ignoreAir = true;
 }
 
 // called when loading saves / stamps to ensure nothing "leaks" the first frame
@@ -403,3 +550,127 @@ Air::Air(Simulation & simulation):
 	std::fill(&pv[0][0], &pv[0][0]+NCELL, 0.0f);
 	std::fill(&opv[0][0], &opv[0][0]+NCELL, 0.0f);
 }
+
+Air::~Air()
+{
+	SetPipelined(false);
+}
+
+void Air::SetPipelined(bool newPipelined)
+{
+	if (newPipelined == IsPipelined())
+		return;
+	if (newPipelined)
+	{
+		pipeline = std::make_unique<AirPipeline>(sim);
+		pipeline->airthread = std::thread([this]() { RunPipelined(); });
+		return;
+	}
+	CollectPipelined();
+	{
+		std::lock_guard<std::mutex> g(pipeline->airmutex);
+		pipeline->airthread_done = true;
+	}
+	pipeline->aircv.notify_one();
+	pipeline->airthread.join();
+	pipeline.reset();
+}
+
+void Air::RunPipelined()
+{
+	auto &pl = *pipeline;
+	std::unique_lock<std::mutex> l(pl.airmutex);
+	while (true)
+	{
+		pl.aircv.wait(l, [&pl]() { return pl.work || pl.airthread_done; });
+		if (pl.airthread_done)
+			break;
+		l.unlock();
+		pl.th_air->update_air();
+		if (pl.th_heat)
+			pl.th_air->UpdateAirHeat();
+		l.lock();
+		pl.work = false;
+		pl.aircv.notify_one();
+	}
+}
+
+// map = result + (map - sent), i.e. the job's result plus whatever else changed the map
+// while the job was running.
+static void AddChanges(float (&map)[YCELLS][XCELLS], const float (&result)[YCELLS][XCELLS], const float (&sent)[YCELLS][XCELLS])
+{
+	for (int y=0; y<YCELLS; y++)
+		for (int x=0; x<XCELLS; x++)
+			map[y][x] = result[y][x] + (map[y][x] - sent[y][x]);
+}
+
+void Air::CollectPipelined()
+{
+	auto &pl = *pipeline;
+	if (!pl.running)
+		return;
+	{
+		std::unique_lock<std::mutex> l(pl.airmutex);
+		pl.aircv.wait(l, [&pl]() { return !pl.work; });
+	}
+	pl.running = false;
+	auto &th = *pl.th_air;
+	if (!pl.ignoreAir)
+	{
+		AddChanges(vx, th.vx, pl.sentVx);
+		AddChanges(vy, th.vy, pl.sentVy);
+		AddChanges(pv, th.pv, pl.sentPv);
+	}
+	if (pl.th_heat && !pl.ignoreHeat)
+	{
+		AddChanges(hv, th.hv, pl.sentHv);
+	}
+	pl.ignoreAir = false;
+	pl.ignoreHeat = false;
+}
+
+void Air::DiscardPipelined()
+{
+	if (pipeline && pipeline->running)
+	{
+		pipeline->ignoreAir = true;
+		pipeline->ignoreHeat = true;
+	}
+}
+
+// Always waits for the previous job, so the results don't depend on how long the thread
+// took, only on the order of the frames.
+void Air::UpdatePipelined(bool heat)
+{
+	CollectPipelined();
+	auto &pl = *pipeline;
+	auto &th = *pl.th_air;
+	memcpy(th.vx, vx, sizeof(vx));
+	memcpy(th.vy, vy, sizeof(vy));
+	memcpy(th.pv, pv, sizeof(pv));
+	memcpy(pl.sentVx, vx, sizeof(vx));
+	memcpy(pl.sentVy, vy, sizeof(vy));
+	memcpy(pl.sentPv, pv, sizeof(pv));
+	if (heat)
+	{
+		memcpy(th.hv, hv, sizeof(hv));
+		memcpy(pl.sentHv, hv, sizeof(hv));
+		// Sampled here rather than on the thread, which mustn't read the gravity maps while
+		// the main thread updates them.
+		th.SampleGravity();
+	}
+	memcpy(th.bmap_blockair, bmap_blockair, sizeof(bmap_blockair));
+	memcpy(th.bmap_blockairh, bmap_blockairh, sizeof(bmap_blockairh));
+	memcpy(pl.th_bmap, bmap, sizeof(pl.th_bmap));
+	memcpy(pl.th_fvx, fvx, sizeof(pl.th_fvx));
+	memcpy(pl.th_fvy, fvy, sizeof(pl.th_fvy));
+	th.airMode = airMode;
+	th.ambientAirTemp = ambientAirTemp;
+	pl.th_heat = heat;
+	{
+		std::lock_guard<std::mutex> g(pl.airmutex);
+		pl.work = true;
+	}
+	pl.aircv.notify_one();
+	pl.running = true;
+}
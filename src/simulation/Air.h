@@ -1,7 +1,12 @@
 #pragma once
 #include "SimulationConfig.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
 
 class Simulation;
+class WorkerPool;
+struct AirPipeline;
 
 class Air
 {
@@ -26,6 +31,7 @@ public:
 	unsigned char bmap_blockair[YCELLS][XCELLS];
 	unsigned char bmap_blockairh[YCELLS][XCELLS];
 	float kernel[9];
+	WorkerPool *workerPool = nullptr; // if set, update_air splits rows between its threads
 	void make_kernel(void);
 	void update_airh(void);
 	void update_air(void);
@@ -34,4 +40,34 @@ public:
 	void Invert();
 	void RecalculateBlockAirMaps();
 	Air(Simulation & sim);
+	~Air();
+
+	// When pipelined, the air and ambient heat updates run one frame behind on a thread of
+	// their own, on a copy of the maps, and UpdatePipelined takes the place of calling
+	// update_air and update_airh. Particles keep changing the maps in the meantime, their
+	// changes are added back onto the result when it is collected.
+	void SetPipelined(bool newPipelined);
+	bool IsPipelined() const { return bool(pipeline); }
+	void UpdatePipelined(bool heat);
+	// Drops the result of the running job, if any. For when all of the maps are replaced, the
+	// difference from what the job was started with is then not a change made by particles.
+	void DiscardPipelined();
+
+private:
+	// Cells whose values the blur in update_air takes from their neighbours, and a copy of
+	// bmap_blockair. Each is a mask of all ones or all zeros, as wide as the
+	// floats it selects between, so the loops that use them vectorise with plain SSE2.
+	uint32_t airOpen[YCELLS][XCELLS];
+	uint32_t airBlocked[YCELLS][XCELLS];
+	// Gravity at the centre of each cell, sampled before update_airh so that it can run
+	// without touching the simulation.
+	float cellGravX[YCELLS][XCELLS];
+	float cellGravY[YCELLS][XCELLS];
+	std::unique_ptr<AirPipeline> pipeline;
+	void SampleGravity();
+	void UpdateAirHeat();
+	void CollectPipelined();
+	void RunPipelined();
+	void ForEachRow(int begin, int end, const std::function<void (int)> &row);
+	void UpdateAirRow(int y);
 };
@@ -0,0 +1,71 @@
+#include "DeltaCompressor.h"
+#include "SnapshotDelta.h"
+#include <algorithm>
+
+DeltaCompressor::DeltaCompressor()
+{
+	thread = std::thread([this]() { ThreadMain(); });
+}
+
+DeltaCompressor::~DeltaCompressor()
+{
+	{
+		std::lock_guard<std::mutex> g(mutex);
+		stopping = true;
+	}
+	queueCv.notify_one();
+	thread.join();
+}
+
+void DeltaCompressor::ThreadMain()
+{
+	std::unique_lock<std::mutex> l(mutex);
+	while (true)
+	{
+		queueCv.wait(l, [this]() { return stopping || !queue.empty(); });
+		if (stopping)
+		{
+			break;
+		}
+		auto *delta = queue.front();
+		queue.pop_front();
+		busy = delta;
+		l.unlock();
+		delta->Compress();
+		l.lock();
+		busy = nullptr;
+		doneCv.notify_all();
+	}
+}
+
+void DeltaCompressor::Push(SnapshotDelta *delta)
+{
+	{
+		std::lock_guard<std::mutex> g(mutex);
+		queue.push_back(delta);
+	}
+	queueCv.notify_one();
+}
+
+bool DeltaCompressor::Settle(SnapshotDelta *delta)
+{
+	if (!delta)
+	{
+		return false;
+	}
+	std::unique_lock<std::mutex> l(mutex);
+	auto it = std::find(queue.begin(), queue.end(), delta);
+	if (it != queue.end())
+	{
+		queue.erase(it);
+		return true;
+	}
+	doneCv.wait(l, [this, delta]() { return busy != delta; });
+	return false;
+}
+
+void DeltaCompressor::Wait()
+{
+	std::unique_lock<std::mutex> l(mutex);
+	doneCv.wait(l, [this]() { return queue.empty() && !busy; });
+}
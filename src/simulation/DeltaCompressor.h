@@ -0,0 +1,39 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+struct SnapshotDelta;
+
+// Calls SnapshotDelta::Compress on queued SnapshotDeltas on a thread of its own. A queued
+// SnapshotDelta belongs to that thread until Settle is called on it, only its Bytes may be
+// looked at in the meantime, and it must be settled before it's used or destroyed.
+class DeltaCompressor
+{
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable queueCv;
+	std::condition_variable doneCv;
+	std::deque<SnapshotDelta *> queue;
+	SnapshotDelta *busy = nullptr;
+	bool stopping = false;
+
+	void ThreadMain();
+
+public:
+	DeltaCompressor();
+	~DeltaCompressor();
+
+	DeltaCompressor(const DeltaCompressor &) = delete;
+	DeltaCompressor &operator =(const DeltaCompressor &) = delete;
+
+	void Push(SnapshotDelta *delta);
+
+	// Takes delta back. Returns true if it was still waiting in the queue, in which case it's
+	// left as it was, otherwise waits for it to be compressed if that's in progress.
+	bool Settle(SnapshotDelta *delta);
+
+	// Waits for everything queued to be compressed.
+	void Wait();
+};
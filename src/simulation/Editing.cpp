@@ -16,25 +16,29 @@
 std::unique_ptr<Snapshot> Simulation::CreateSnapshot()
 {
 	auto snap = std::make_unique<Snapshot>();
-	snap->AirPressure    .insert   (snap->AirPressure    .begin(), &pv  [0][0]      , &pv  [0][0] + NCELL);
-	snap->AirVelocityX   .insert   (snap->AirVelocityX   .begin(), &vx  [0][0]      , &vx  [0][0] + NCELL);
-	snap->AirVelocityY   .insert   (snap->AirVelocityY   .begin(), &vy  [0][0]      , &vy  [0][0] + NCELL);
-	snap->AmbientHeat    .insert   (snap->AmbientHeat    .begin(), &hv  [0][0]      , &hv  [0][0] + NCELL);
-	snap->BlockMap       .insert   (snap->BlockMap       .begin(), &bmap[0][0]      , &bmap[0][0] + NCELL);
-	snap->ElecMap        .insert   (snap->ElecMap        .begin(), &emap[0][0]      , &emap[0][0] + NCELL);
-	snap->FanVelocityX   .insert   (snap->FanVelocityX   .begin(), &fvx [0][0]      , &fvx [0][0] + NCELL);
-	snap->FanVelocityY   .insert   (snap->FanVelocityY   .begin(), &fvy [0][0]      , &fvy [0][0] + NCELL);
-	snap->GravVelocityX  .insert   (snap->GravVelocityX  .begin(), &gravx  [0]      , &gravx  [0] + NCELL);
-	snap->GravVelocityY  .insert   (snap->GravVelocityY  .begin(), &gravy  [0]      , &gravy  [0] + NCELL);
-	snap->GravValue      .insert   (snap->GravValue      .begin(), &gravp  [0]      , &gravp  [0] + NCELL);
-	snap->GravMap        .insert   (snap->GravMap        .begin(), &gravmap[0]      , &gravmap[0] + NCELL);
-	snap->Particles      .insert   (snap->Particles      .begin(), &parts  [0]      , &parts  [0] + parts_lastActiveIndex + 1);
-	snap->PortalParticles.insert   (snap->PortalParticles.begin(), &portalp[0][0][0], &portalp[0][0][0] + CHANNELS * 8 * 80);
+	// Tiles that haven't changed since the last Snapshot are shared with it rather than copied,
+	// which also lets SnapshotDelta::FromSnapshots skip them.
+	auto *last = lastSnapshot.get();
+	snap->AirPressure    .Assign   (&pv  [0][0]      , NCELL                    , last ? &last->AirPressure     : nullptr);
+	snap->AirVelocityX   .Assign   (&vx  [0][0]      , NCELL                    , last ? &last->AirVelocityX    : nullptr);
+	snap->AirVelocityY   .Assign   (&vy  [0][0]      , NCELL                    , last ? &last->AirVelocityY    : nullptr);
+	snap->AmbientHeat    .Assign   (&hv  [0][0]      , NCELL                    , last ? &last->AmbientHeat     : nullptr);
+	snap->BlockMap       .Assign   (&bmap[0][0]      , NCELL                    , last ? &last->BlockMap        : nullptr);
+	snap->ElecMap        .Assign   (&emap[0][0]      , NCELL                    , last ? &last->ElecMap         : nullptr);
+	snap->FanVelocityX   .Assign   (&fvx [0][0]      , NCELL                    , last ? &last->FanVelocityX    : nullptr);
+	snap->FanVelocityY   .Assign   (&fvy [0][0]      , NCELL                    , last ? &last->FanVelocityY    : nullptr);
+	snap->GravVelocityX  .Assign   (&gravx  [0]      , NCELL                    , last ? &last->GravVelocityX   : nullptr);
+	snap->GravVelocityY  .Assign   (&gravy  [0]      , NCELL                    , last ? &last->GravVelocityY   : nullptr);
+	snap->GravValue      .Assign   (&gravp  [0]      , NCELL                    , last ? &last->GravValue       : nullptr);
+	snap->GravMap        .Assign   (&gravmap[0]      , NCELL                    , last ? &last->GravMap         : nullptr);
+	snap->Particles      .Assign   (&parts  [0]      , parts_lastActiveIndex + 1, last ? &last->Particles       : nullptr);
+	snap->PortalParticles.Assign   (&portalp[0][0][0], CHANNELS * 8 * 80        , last ? &last->PortalParticles : nullptr);
 	snap->WirelessData   .insert   (snap->WirelessData   .begin(), &wireless[0][0]  , &wireless[0][0] + CHANNELS * 2);
 	snap->stickmen       .insert   (snap->stickmen       .begin(), &fighters[0]     , &fighters[0] + MAX_FIGHTERS);
 	snap->stickmen       .push_back(player2);
 	snap->stickmen       .push_back(player);
 	snap->signs = signs;
+	lastSnapshot = std::make_unique<Snapshot>(*snap);
 	return snap;
 }
 
@@ -43,37 +47,45 @@ void Simulation::Restore(const Snapshot &snap)
 	std::fill(elementCount, elementCount + PT_NUM, 0);
 	elementRecount = true;
 	force_stacking_check = true;
-	for (auto &part : parts)
-	{
-		part.type = 0;
-	}
-	std::copy(snap.AirPressure    .begin(), snap.AirPressure    .end(), &pv[0][0]        );
-	std::copy(snap.AirVelocityX   .begin(), snap.AirVelocityX   .end(), &vx[0][0]        );
-	std::copy(snap.AirVelocityY   .begin(), snap.AirVelocityY   .end(), &vy[0][0]        );
-	std::copy(snap.AmbientHeat    .begin(), snap.AmbientHeat    .end(), &hv[0][0]        );
-	std::copy(snap.BlockMap       .begin(), snap.BlockMap       .end(), &bmap[0][0]      );
-	std::copy(snap.ElecMap        .begin(), snap.ElecMap        .end(), &emap[0][0]      );
-	std::copy(snap.FanVelocityX   .begin(), snap.FanVelocityX   .end(), &fvx[0][0]       );
-	std::copy(snap.FanVelocityY   .begin(), snap.FanVelocityY   .end(), &fvy[0][0]       );
+	air->DiscardPipelined();
+	snap.AirPressure    .CopyTo(&pv[0][0]        );
+	snap.AirVelocityX   .CopyTo(&vx[0][0]        );
+	snap.AirVelocityY   .CopyTo(&vy[0][0]        );
+	snap.AmbientHeat    .CopyTo(&hv[0][0]        );
+	snap.BlockMap       .CopyTo(&bmap[0][0]      );
+	snap.ElecMap        .CopyTo(&emap[0][0]      );
+	snap.FanVelocityX   .CopyTo(&fvx[0][0]       );
+	snap.FanVelocityY   .CopyTo(&fvy[0][0]       );
 	if (grav->IsEnabled())
 	{
 		grav->Clear();
-		std::copy(snap.GravVelocityX.begin(), snap.GravVelocityX.end(), &gravx  [0]      );
-		std::copy(snap.GravVelocityY.begin(), snap.GravVelocityY.end(), &gravy  [0]      );
-		std::copy(snap.GravValue    .begin(), snap.GravValue    .end(), &gravp  [0]      );
-		std::copy(snap.GravMap      .begin(), snap.GravMap      .end(), &gravmap[0]      );
+		snap.GravVelocityX.CopyTo(&gravx  [0]      );
+		snap.GravVelocityY.CopyTo(&gravy  [0]      );
+		snap.GravValue    .CopyTo(&gravp  [0]      );
+		snap.GravMap      .CopyTo(&gravmap[0]      );
+	}
+	snap.Particles      .CopyTo(&parts[0]        );
+	// Only the slots that were in use and aren't overwritten need clearing, everything past
+	// parts_lastActiveIndex is already empty and chained in order, see clear_sim
+	int count = int(snap.Particles.size());
+	for (int i = count; i <= parts_lastActiveIndex; i++)
+	{
+		parts[i] = Particle();
+		parts[i].life = (i == NPART - 1) ? -1 : i + 1;
+		typeIndex.Remove(i);
 	}
-	std::copy(snap.Particles      .begin(), snap.Particles      .end(), &parts[0]        );
-	std::copy(snap.PortalParticles.begin(), snap.PortalParticles.end(), &portalp[0][0][0]);
+	snap.PortalParticles.CopyTo(&portalp[0][0][0]);
 	std::copy(snap.WirelessData   .begin(), snap.WirelessData   .end(), &wireless[0][0]  );
 	std::copy(snap.stickmen       .begin(), snap.stickmen.end() - 2   , &fighters[0]     );
 	player  = snap.stickmen[snap.stickmen.size() - 1];
 	player2 = snap.stickmen[snap.stickmen.size() - 2];
 	signs = snap.signs;
-	parts_lastActiveIndex = NPART - 1;
+	parts_lastActiveIndex = std::max(count, 1) - 1;
 	air->RecalculateBlockAirMaps();
+	ResetPmap();
 	RecalcFreeParticles(false);
 	gravWallChanged = true;
+	lastSnapshot = std::make_unique<Snapshot>(snap);
 }
 
 void Simulation::clear_area(int area_x, int area_y, int area_w, int area_h)
@@ -0,0 +1,105 @@
+#include "GolMap.h"
+#include <algorithm>
+
+GolMap::GolMap() : tileLists(tilesX * tilesY), alive((width + 2) * (height + 2), 0)
+{
+}
+
+void GolMap::Clear()
+{
+	occupied = {};
+	for (auto &rowSpans : spans)
+	{
+		rowSpans.clear();
+	}
+	for (auto &tile : tileLists)
+	{
+		tile.reset();
+	}
+	std::fill(alive.begin(), alive.end(), 0);
+	aliveCells.clear();
+	contributors.clear();
+}
+
+void GolMap::BuildSpans()
+{
+	for (int ty = 0; ty < tilesY; ty++)
+	{
+		auto &rowSpans = spans[ty];
+		rowSpans.clear();
+		for (int tx = 0; tx < tilesX; tx++)
+		{
+			bool active = false;
+			for (int ny = ty - 1; ny <= ty + 1 && !active; ny++)
+			{
+				for (int nx = tx - 1; nx <= tx + 1; nx++)
+				{
+					// Tiles on opposite edges are neighbours too, as the GoL area wraps around.
+					if (occupied[((ny + tilesY) % tilesY) * tilesX + (nx + tilesX) % tilesX])
+					{
+						active = true;
+						break;
+					}
+				}
+			}
+			if (!active)
+			{
+				continue;
+			}
+			int begin = CELL + tx * tileSize;
+			int end = CELL + std::min((tx + 1) * tileSize, width);
+			if (!rowSpans.empty() && rowSpans.back().end == begin)
+			{
+				rowSpans.back().end = end;
+			}
+			else
+			{
+				rowSpans.push_back({ begin, end });
+			}
+		}
+	}
+	occupied = {};
+}
+
+void GolMap::SetAlive(int x, int y)
+{
+	int gx = x - CELL + 1;
+	int gy = y - CELL + 1;
+	// Cells on the edges also go in the border on the opposite side.
+	int xs[] = { gx, gx == 1 ? width + 1 : gx == width ? 0 : -1 };
+	int ys[] = { gy, gy == 1 ? height + 1 : gy == height ? 0 : -1 };
+	for (auto ay : ys)
+	{
+		for (auto ax : xs)
+		{
+			if (ax >= 0 && ay >= 0)
+			{
+				alive[ay * gridStride + ax] = 1;
+				aliveCells.push_back(ay * gridStride + ax);
+			}
+		}
+	}
+}
+
+void GolMap::CountNeighbours(int y, int begin, int end, unsigned char *counts) const
+{
+	auto *above = &alive[(y - CELL) * gridStride];
+	auto *row = above + gridStride;
+	auto *below = row + gridStride;
+	int offset = 1 - CELL;
+	for (int x = begin; x < end; x++)
+	{
+		int g = x + offset;
+		counts[x] = above[g - 1] + above[g] + above[g + 1] + row[g - 1] + row[g + 1] + below[g - 1] + below[g] + below[g + 1];
+	}
+}
+
+void GolMap::ClearAlive()
+{
+	auto *grid = alive.data();
+	for (auto index : aliveCells)
+	{
+		grid[index] = 0;
+	}
+	aliveCells.clear();
+}
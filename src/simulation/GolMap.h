@@ -0,0 +1,110 @@
+#pragma once
+#include "SimulationConfig.h"
+#include <array>
+#include <memory>
+#include <vector>
+
+// Scratch space for Simulation::SimulateGoL. The GoL area, which wraps around, is split into
+// tiles of tileSize by tileSize pixels and a generation only visits tiles with LIFE particles
+// in or next to them. Neighbour lists are kept per tile, and only tiles that have needed them
+// at some point have them allocated.
+//
+// Most GoL saves use a single rule and no stacking; neighbour lists are then unnecessary, as
+// every neighbour is of the same kind. For these, live cells are instead marked in a byte
+// grid with a border that mirrors the opposite edges, and neighbours are counted a row of
+// active tiles at a time with a loop that vectorises.
+class GolMap
+{
+public:
+	static constexpr int tileSize = 16;
+	static constexpr int width = XRES - 2 * CELL;
+	static constexpr int height = YRES - 2 * CELL;
+	static constexpr int tilesX = (width + tileSize - 1) / tileSize;
+	static constexpr int tilesY = (height + tileSize - 1) / tileSize;
+
+	using NeighbourList = unsigned int[5];
+
+	// A run of active tiles in one row of tiles, in simulation x coordinates, end excluded.
+	struct Span
+	{
+		int begin, end;
+	};
+
+private:
+	struct TileLists
+	{
+		NeighbourList lists[tileSize * tileSize] = {};
+	};
+	static constexpr int gridStride = width + 2;
+
+	std::array<bool, tilesX * tilesY> occupied{};
+	std::array<std::vector<Span>, tilesY> spans;
+	std::vector<std::unique_ptr<TileLists>> tileLists;
+	std::vector<unsigned char> alive;
+	std::vector<int> aliveCells;
+
+	static int TileIndex(int x, int y)
+	{
+		return ((y - CELL) / tileSize) * tilesX + (x - CELL) / tileSize;
+	}
+
+	static int CellIndex(int x, int y)
+	{
+		return ((y - CELL) % tileSize) * tileSize + (x - CELL) % tileSize;
+	}
+
+public:
+	// IDs of the LIFE particles that count as neighbours in the current generation.
+	std::vector<int> contributors;
+
+	GolMap();
+
+	void Clear();
+
+	// Coordinates are simulation coordinates inside the GoL area.
+	void MarkTile(int x, int y)
+	{
+		occupied[TileIndex(x, y)] = true;
+	}
+
+	// Turns the tiles marked since the previous call, and their neighbours, into spans,
+	// and clears the marks.
+	void BuildSpans();
+
+	const std::vector<Span> &Spans(int y) const
+	{
+		return spans[(y - CELL) / tileSize];
+	}
+
+	// Allocates the lists of the tile if needed. Lists start out zeroed, SimulateGoL zeroes
+	// them again after use.
+	NeighbourList &List(int x, int y)
+	{
+		auto &tile = tileLists[TileIndex(x, y)];
+		if (!tile)
+		{
+			tile = std::make_unique<TileLists>();
+		}
+		return tile->lists[CellIndex(x, y)];
+	}
+
+	// nullptr if the tile has never needed lists, in which case they would all be zero.
+	NeighbourList *FindList(int x, int y)
+	{
+		auto &tile = tileLists[TileIndex(x, y)];
+		return tile ? &tile->lists[CellIndex(x, y)] : nullptr;
+	}
+
+	void SetAlive(int x, int y);
+
+	bool Alive(int x, int y) const
+	{
+		return alive[(y - CELL + 1) * gridStride + x - CELL + 1];
+	}
+
+	// Stores the number of live neighbours of each cell of row y between begin and end in
+	// counts[x].
+	void CountNeighbours(int y, int begin, int end, unsigned char *counts) const;
+
+	void ClearAlive();
+};
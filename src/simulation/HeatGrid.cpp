@@ -0,0 +1,68 @@
+#include "HeatGrid.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+HeatGrid::HeatGrid() :
+	temp(XRES * YRES, 0.0f),
+	capacity(XRES * YRES, 1.0f),
+	rate(XRES * YRES, 0.0f),
+	group(XRES * YRES, 0),
+	nextTemp(XRES * YRES, 0.0f)
+{
+}
+
+void HeatGrid::ClearRow(int y)
+{
+	std::fill(&rate[y * XRES], &rate[y * XRES] + XRES, 0.0f);
+	std::fill(&capacity[y * XRES], &capacity[y * XRES] + XRES, 1.0f);
+	rowActive[y] = false;
+}
+
+// Zeroes value unless keep is set. Written with bit operations because the compiler only
+// vectorises a float ternary with SSE4.1 and up, like Select in Air.cpp.
+static inline float KeepIf(bool keep, float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	bits &= keep ? UINT32_C(0xFFFFFFFF) : 0U;
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+void HeatGrid::Conduct()
+{
+	constexpr int offsets[] = {
+		-XRES - 1, -XRES, -XRES + 1,
+		        -1,                1,
+		 XRES - 1,  XRES,  XRES + 1,
+	};
+	auto *T = temp.data();
+	auto *C = capacity.data();
+	auto *K = rate.data();
+	auto *G = group.data();
+	auto *out = nextTemp.data();
+	for (int y = CELL; y < YRES - CELL; y++)
+	{
+		if (!rowActive[y])
+		{
+			continue;
+		}
+		int begin = y * XRES + CELL;
+		int end = y * XRES + XRES - CELL;
+		// No branches in here, so this vectorises
+		for (int c = begin; c < end; c++)
+		{
+			float flow = 0.0f;
+			for (auto o : offsets)
+			{
+				int n = c + o;
+				float pair = std::min(K[c], K[n]) * std::min(C[c], C[n]) * (1.0f / 9.0f);
+				pair = KeepIf((G[c] | G[n]) != (groupFilt | groupNoFilt), pair);
+				flow += pair * (T[n] - T[c]);
+			}
+			out[c] = T[c] + flow / C[c];
+		}
+	}
+}
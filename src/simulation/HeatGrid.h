@@ -0,0 +1,33 @@
+#pragma once
+#include "SimulationConfig.h"
+#include <array>
+#include <vector>
+
+// Per-pixel buffers for Simulation::ConductHeatGrid, which runs heat conduction between the
+// particles on top of pmap as one stencil pass instead of in the particle loop. Every pair of
+// neighbouring pixels exchanges heat in proportion to their temperature difference, the
+// smaller of their conduction rates and the smaller of their heat capacities, so heat is
+// conserved and no pixel can overshoot the temperatures around it.
+class HeatGrid
+{
+public:
+	// Pixels in different groups other than 0 don't exchange heat, see Simulation::ConductHeatGrid.
+	static constexpr unsigned char groupFilt = 1;
+	static constexpr unsigned char groupNoFilt = 2;
+
+	std::vector<float> temp;
+	std::vector<float> capacity; // 1 where rate is 0
+	std::vector<float> rate; // chance of conducting in a frame, 0 for pixels that don't
+	std::vector<unsigned char> group;
+	std::vector<float> nextTemp;
+	// Rows that may have pixels with a non-zero rate. Rows that don't are skipped.
+	std::array<bool, YRES> rowActive{};
+
+	HeatGrid();
+
+	// Sets the rate of every pixel of the row to 0.
+	void ClearRow(int y);
+
+	// Computes nextTemp for the active rows between CELL and YRES - CELL.
+	void Conduct();
+};
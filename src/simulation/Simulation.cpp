@@ -4,12 +4,18 @@
 #include "gravity/Gravity.h"
 #include "ToolClasses.h"
 #include "SimulationData.h"
+#include "Snapshot.h"
 #include "GOLString.h"
 #include "client/GameSave.h"
 #include "common/tpt-compat.h"
 #include "common/tpt-rand.h"
 #include "common/tpt-thread-local.h"
+#include "common/WorkerPool.h"
 #include "gui/game/Brush.h"
+#include "Config.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <iostream>
 #include <set>
 
@@ -133,13 +139,13 @@ int Simulation::Load(const GameSave * originalSave, bool includePressure, int fu
 		if (pmap[y][x])
 		{
 			// Particle already exists in this location. Set pmap to 0, then kill it and all stacked particles in the loop below
-			pmap[y][x] = 0;
+			SetPmap(x, y, 0);
 			doFullScan = true;
 		}
 		else if (photons[y][x])
 		{
 			// Particle already exists in this location. Set photons to 0, then kill it and all stacked particles in the loop below
-			photons[y][x] = 0;
+			SetPhotons(x, y, 0);
 			doFullScan = true;
 		}
 	}
@@ -767,12 +773,9 @@ bool Simulation::flood_water(int x, int y, int i)
 					else if (!eval_move(parts[i].type, x, y - 1, nullptr))
 						continue;
 
-					int oldx = (int)(parts[i].x + 0.5f);
-					int oldy = (int)(parts[i].y + 0.5f);
-					pmap[y - 1][x] = pmap[oldy][oldx];
-					pmap[oldy][oldx] = 0;
 					parts[i].x = float(x);
 					parts[i].y = float(y - 1);
+					PmapAdd(i, x, y - 1);
 					return true;
 				}
 
@@ -1085,14 +1088,17 @@ void Simulation::clear_sim(void)
 	for (int i = 0; i < NPART-1; i++)
 		parts[i].life = i+1;
 	parts[NPART-1].life = -1;
+	sleepMap.Clear();
+	typeIndex.Clear();
+	spatialIndex.Clear();
 	pfree = 0;
 	parts_lastActiveIndex = 0;
-	memset(pmap, 0, sizeof(pmap));
+	ResetPmap();
+	std::fill(heatGridTick.begin(), heatGridTick.end(), -1);
 	memset(fvx, 0, sizeof(fvx));
 	memset(fvy, 0, sizeof(fvy));
-	memset(photons, 0, sizeof(photons));
 	memset(wireless, 0, sizeof(wireless));
-	memset(gol, 0, sizeof(gol));
+	golMap.Clear();
 	memset(portalp, 0, sizeof(portalp));
 	memset(fighters, 0, sizeof(fighters));
 	memset(&player, 0, sizeof(player));
@@ -1431,6 +1437,7 @@ int Simulation::try_move(int i, int x, int y, int nx, int ny)
 				{
 					portalp[parts[ID(r)].tmp][count][nnx] = parts[i];
 					parts[i].type=PT_NONE;
+					typeIndex.Remove(i);
 					break;
 				}
 		}
@@ -1661,30 +1668,26 @@ int Simulation::try_move(int i, int x, int y, int nx, int ny)
 			// if nothing is currently underneath neutron, only move target particle
 			if(bmap[y/CELL][x/CELL] == WL_ALLOWENERGY)
 				return 1; // do not drag target particle into an energy only wall
+			PmapRemove(ri);
 			if (s)
 			{
-				pmap[ny][nx] = (s&~PMAPMASK)|parts[ID(s)].type;
 				parts[ID(s)].x = float(nx);
 				parts[ID(s)].y = float(ny);
+				PmapAdd(ID(s), nx, ny);
 			}
-			else
-				pmap[ny][nx] = 0;
 			parts[ri].x = float(x);
 			parts[ri].y = float(y);
-			pmap[y][x] = PMAP(ri, parts[ri].type);
+			PmapAdd(ri, x, y);
 			return 1;
 		}
 
-		if (ID(pmap[ny][nx]) == ri)
-			pmap[ny][nx] = 0;
 		parts[ri].x += float(x - nx);
 		parts[ri].y += float(y - ny);
 		int rx = int(parts[ri].x + 0.5f);
 		int ry = int(parts[ri].y + 0.5f);
-		// This check will never fail unless the pmap array has already been corrupted via another bug
-		// In that case, r's position is inaccurate (not actually at nx/ny) and rx/ry may be out of bounds
-		if (InBounds(rx, ry))
-			pmap[ry][rx] = PMAP(ri, parts[ri].type);
+		// rx/ry are only out of bounds if the pmap array has already been corrupted via another bug,
+		// in which case r's position is inaccurate (not actually at nx/ny), PmapAdd leaves r out then
+		PmapAdd(ri, rx, ry);
 	}
 	return 1;
 }
@@ -1731,20 +1734,14 @@ bool Simulation::move(int i, int x, int y, float nxf, float nyf)
 	parts[i].y = nyf;
 	if (ny != y || nx != x)
 	{
-		if (ID(pmap[y][x]) == i)
-			pmap[y][x] = 0;
-		if (ID(photons[y][x]) == i)
-			photons[y][x] = 0;
 		// kill_part if particle is out of bounds
 		if (nx < CELL || nx >= XRES - CELL || ny < CELL || ny >= YRES - CELL)
 		{
 			kill_part(i);
 			return false;
 		}
-		if (elements[t].Properties & TYPE_ENERGY)
-			photons[ny][nx] = PMAP(i, t);
-		else if (t)
-			pmap[ny][nx] = PMAP(i, t);
+		if (t)
+			PmapAdd(i, nx, ny);
 	}
 
 	return true;
@@ -1943,13 +1940,7 @@ void Simulation::kill_part(int i)//kills particle number i
 		(*(elements[t].ChangeType))(this, i, x, y, t, PT_NONE);
 	}
 
-	if (x >= 0 && y >= 0 && x < XRES && y < YRES)
-	{
-		if (ID(pmap[y][x]) == i)
-			pmap[y][x] = 0;
-		else if (ID(photons[y][x]) == i)
-			photons[y][x] = 0;
-	}
+	PmapRemove(i);
 
 	// This shouldn't happen but ... you never know?
 	if (t == PT_NONE)
@@ -1958,6 +1949,7 @@ void Simulation::kill_part(int i)//kills particle number i
 	elementCount[t]--;
 
 	parts[i].type = PT_NONE;
+	typeIndex.Remove(i);
 	parts[i].life = pfree;
 	pfree = i;
 }
@@ -1989,18 +1981,8 @@ bool Simulation::part_change_type(int i, int x, int y, int t)
 	elementCount[t]++;
 
 	parts[i].type = t;
-	if (elements[t].Properties & TYPE_ENERGY)
-	{
-		photons[y][x] = PMAP(i, t);
-		if (ID(pmap[y][x]) == i)
-			pmap[y][x] = 0;
-	}
-	else
-	{
-		pmap[y][x] = PMAP(i, t);
-		if (ID(photons[y][x]) == i)
-			photons[y][x] = 0;
-	}
+	typeIndex.Add(i, t);
+	PmapAdd(i, x, y);
 	return false;
 }
 
@@ -2030,9 +2012,10 @@ int Simulation::create_part(int p, int x, int y, int t, int v)
 			return index;
 		}
 		parts[index].type = PT_SPRK;
+		typeIndex.Add(index, PT_SPRK);
 		parts[index].life = 4;
 		parts[index].ctype = type;
-		pmap[y][x] = (pmap[y][x]&~PMAPMASK) | PT_SPRK;
+		PmapAdd(index, x, y);
 		if (parts[index].temp+10.0f < 673.0f && !legacy_enable && (type==PT_METL || type == PT_BMTL || type == PT_BRMT || type == PT_PSCN || type == PT_NSCN || type == PT_ETRD || type == PT_NBLE || type == PT_IRON))
 			parts[index].temp = parts[index].temp+10.0f;
 		return index;
@@ -2092,10 +2075,7 @@ int Simulation::create_part(int p, int x, int y, int t, int v)
 	{
 		int oldX = (int)(parts[p].x + 0.5f);
 		int oldY = (int)(parts[p].y + 0.5f);
-		if (ID(pmap[oldY][oldX]) == p)
-			pmap[oldY][oldX] = 0;
-		if (ID(photons[oldY][oldX]) == p)
-			photons[oldY][oldX] = 0;
+		PmapRemove(p);
 
 		oldType = parts[p].type;
 
@@ -2108,17 +2088,20 @@ int Simulation::create_part(int p, int x, int y, int t, int v)
 	}
 
 	if (i>parts_lastActiveIndex) parts_lastActiveIndex = i;
+	// whatever used to be in this slot may have been updated already, the new particle hasn't been
+	if (!updatedInParallel.empty())
+		updatedInParallel[i] = 0;
+	if (!heatGridTick.empty())
+		heatGridTick[i] = -1;
 
 	parts[i] = elements[t].DefaultProperties;
 	parts[i].type = t;
+	typeIndex.Add(i, t);
 	parts[i].x = (float)x;
 	parts[i].y = (float)y;
 
 	//and finally set the pmap/photon maps to the newly created particle
-	if (elements[t].Properties & TYPE_ENERGY)
-		photons[y][x] = PMAP(i, t);
-	else if (t!=PT_STKM && t!=PT_STKM2 && t!=PT_FIGH)
-		pmap[y][x] = PMAP(i, t);
+	PmapAdd(i, x, y, (elements[t].Properties & TYPE_ENERGY) || (t!=PT_STKM && t!=PT_STKM2 && t!=PT_FIGH));
 
 	//Fancy dust effects for powder types
 	if((elements[t].Properties & TYPE_PART) && pretty_powder)
@@ -2210,6 +2193,7 @@ void Simulation::create_gain_photon(int pp)//photons from PHOT going through GLO
 	if (i>parts_lastActiveIndex) parts_lastActiveIndex = i;
 
 	parts[i].type = PT_PHOT;
+	typeIndex.Add(i, PT_PHOT);
 	parts[i].life = 680;
 	parts[i].x = xx;
 	parts[i].y = yy;
@@ -2219,7 +2203,7 @@ void Simulation::create_gain_photon(int pp)//photons from PHOT going through GLO
 	parts[i].tmp = 0;
 	parts[i].tmp3 = 0;
 	parts[i].tmp4 = 0;
-	photons[ny][nx] = PMAP(i, PT_PHOT);
+	PmapAdd(i, nx, ny);
 
 	temp_bin = (int)((parts[i].temp-273.0f)*0.25f);
 	if (temp_bin < 0) temp_bin = 0;
@@ -2250,6 +2234,7 @@ void Simulation::create_cherenkov_photon(int pp)//photons from NEUT going throug
 	lr = RNG::Ref().between(0, 1);
 
 	parts[i].type = PT_PHOT;
+	typeIndex.Add(i, PT_PHOT);
 	parts[i].ctype = 0x00000F80;
 	parts[i].life = 680;
 	parts[i].x = parts[pp].x;
@@ -2258,7 +2243,7 @@ void Simulation::create_cherenkov_photon(int pp)//photons from NEUT going throug
 	parts[i].tmp = 0;
 	parts[i].tmp3 = 0;
 	parts[i].tmp4 = 0;
-	photons[ny][nx] = PMAP(i, PT_PHOT);
+	PmapAdd(i, nx, ny);
 
 	if (lr) {
 		parts[i].vx = parts[pp].vx - 2.5f*parts[pp].vy;
@@ -2288,8 +2273,407 @@ void Simulation::delete_part(int x, int y)//calls kill_part with the particle lo
 	kill_part(ID(i));
 }
 
+void Simulation::SetUpdateThreads(int newUpdateThreads)
+{
+	if (newUpdateThreads <= 1)
+	{
+		air->workerPool = nullptr;
+		updatePool.reset();
+		updatedInParallel.clear();
+		return;
+	}
+	updatePool = std::make_unique<WorkerPool>(newUpdateThreads);
+	updatedInParallel.assign(NPART, 0);
+	// the air update gives the same results however it is split up
+	air->workerPool = updatePool.get();
+}
+
+int Simulation::GetUpdateThreads() const
+{
+	return updatePool ? updatePool->GetThreadCount() : 1;
+}
+
+void Simulation::UpdateStaticTypes()
+{
+	for (int t = 0; t < PT_NUM; t++)
+	{
+		auto &el = elements[t];
+		staticType[t] = el.Enabled && !el.Update && (el.Properties&TYPE_SOLID) && !el.Advection && !el.Diffusion && !el.HotAir;
+	}
+	// handled specially in the serial loop
+	for (auto t : { PT_ICEI, PT_SNOW, PT_LAVA, PT_LIFE, PT_WIRE, PT_SPRK, PT_HSWC, PT_FILT, PT_GEL, PT_SPNG, PT_ELEC, PT_DEUT, PT_PHOT })
+	{
+		staticType[t] = false;
+	}
+}
+
+bool Simulation::IsStaticParticle(const Particle &part, int x, int y) const
+{
+	return staticType[part.type] && !part.vx && !part.vy &&
+	       x>=CELL && y>=CELL && x<XRES-CELL && y<YRES-CELL && !bmap[y/CELL][x/CELL];
+}
+
+// A sleeping particle isn't updated at all, so it also mustn't be about to exchange heat with
+// the air or its neighbours or be triggered by something outside its cell.
+bool Simulation::CanSleep(const Particle &part, int x, int y) const
+{
+	if (!IsStaticParticle(part, x, y) || StaticParticleTriggered(part, x, y))
+		return false;
+	if (aheat_enable && !(elements[part.type].Properties&PROP_NOAMBHEAT) && std::abs(hv[y/CELL][x/CELL]-part.temp) > 0.1f)
+		return false;
+	// Conduction only happens on some frames at random, so a slow conductor can look settled
+	// for a while with a gradient across it; it has to have actually evened out.
+	if (elements[part.type].HeatConduct)
+	{
+		for (int ny = -1; ny <= 1; ny++)
+		{
+			for (int nx = -1; nx <= 1; nx++)
+			{
+				auto r = pmap[y+ny][x+nx];
+				auto rt = TYP(r);
+				if ((nx || ny) && rt && elements[rt].HeatConduct && (rt!=PT_HSWC||parts[ID(r)].life==10) &&
+				    std::abs(parts[ID(r)].temp-part.temp) > 0.1f)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Whether a static particle would spark from a wall, explode or change type because of
+// pressure or gravity this frame.
+bool Simulation::StaticParticleTriggered(const Particle &part, int x, int y) const
+{
+	auto &el = elements[part.type];
+	if (el.Properties&PROP_CONDUCTS)
+	{
+		int nx = x % CELL;
+		if (nx == 0)
+			nx = x/CELL - 1;
+		else if (nx == CELL-1)
+			nx = x/CELL + 1;
+		else
+			nx = x/CELL;
+		int ny = y % CELL;
+		if (ny == 0)
+			ny = y/CELL - 1;
+		else if (ny == CELL-1)
+			ny = y/CELL + 1;
+		else
+			ny = y/CELL;
+		if (nx>=0 && ny>=0 && nx<XCELLS && ny<YCELLS && emap[ny][nx]==12 && !part.life && bmap[ny][nx] != WL_STASIS)
+			return true;
+	}
+	if ((el.Explosive&2) && pv[y/CELL][x/CELL]>2.5f)
+		return true;
+	float gravtot = fabs(gravy[(y/CELL)*XCELLS+(x/CELL)])+fabs(gravx[(y/CELL)*XCELLS+(x/CELL)]);
+	if (el.HighPressureTransition>-1 && (pv[y/CELL][x/CELL]>el.HighPressure || gravtot>(el.HighPressure/4.0f)))
+		return true;
+	if (el.LowPressureTransition>-1 && pv[y/CELL][x/CELL]<el.LowPressure && gravtot<=(el.LowPressure/4.0f))
+		return true;
+	return false;
+}
+
+// Air and gravity are never quite still, so they aren't part of the signature; whether
+// they would make a sleeping particle do something is checked every frame instead, see
+// StaticParticleTriggered.
+void Simulation::UpdateSleepMap()
+{
+	auto floatBits = [](float value) {
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	};
+	sleepMap.Begin();
+	for (int i = 0; i <= parts_lastActiveIndex; i++)
+	{
+		auto &part = parts[i];
+		if (!part.type)
+			continue;
+		int x = (int)(part.x+0.5f);
+		int y = (int)(part.y+0.5f);
+		if (x<0 || y<0 || x>=XRES || y>=YRES)
+			continue;
+		auto cx = x/CELL;
+		auto cy = y/CELL;
+		// fields are combined independently of each other first, so there's only one dependent step per particle
+		sleepMap.Add(cx, cy,
+			uint32_t(i)              * UINT32_C(0x9E3779B1) ^
+			uint32_t(part.type)      * UINT32_C(0x85EBCA77) ^
+			floatBits(part.x)        * UINT32_C(0xC2B2AE3D) ^
+			floatBits(part.y)        * UINT32_C(0x27D4EB2F) ^
+			floatBits(part.vx)       * UINT32_C(0x165667B1) ^
+			floatBits(part.vy)       * UINT32_C(0xD3A2646D) ^
+			floatBits(part.temp)     * UINT32_C(0xFD7046C5) ^
+			uint32_t(part.life)      * UINT32_C(0xB55A4F09) ^
+			uint32_t(part.ctype)     * UINT32_C(0x68E31DA5) ^
+			uint32_t(part.flags)     * UINT32_C(0x1B873593) ^
+			uint32_t(part.tmp)       * UINT32_C(0xCC9E2D51) ^
+			uint32_t(part.tmp2)      * UINT32_C(0xE6546B65) ^
+			uint32_t(part.tmp3)      * UINT32_C(0x7FEB352D) ^
+			uint32_t(part.tmp4)      * UINT32_C(0x846CA68B));
+	}
+	for (int cy = 0; cy < YCELLS; cy++)
+	{
+		for (int cx = 0; cx < XCELLS; cx++)
+		{
+			sleepMap.Add(cx, cy, uint32_t(bmap[cy][cx]) | (uint32_t(emap[cy][cx]) << 8));
+		}
+	}
+	sleepMap.Commit();
+}
+
+void Simulation::SetSleepingRegions(bool newSleepingRegions)
+{
+	sleepingRegions = newSleepingRegions;
+	sleepMap.Clear();
+}
+
+void Simulation::SetHeatGrid(bool newHeatGrid)
+{
+	heatGridEnabled = newHeatGrid;
+	heatGridPass = false;
+	if (heatGridEnabled)
+		heatGridTick.assign(NPART, -1);
+	else
+		heatGridTick.clear();
+}
+
+// Conducts heat between the particles on top of pmap the way the particle loop would on
+// average, all at once: a pixel's rate is the chance that the particle loop would let its
+// particle conduct in a frame, see HeatGrid for how rates and capacities combine. The particle
+// loop still rolls that chance for ambient heat and state changes, but no longer averages
+// temperatures with the neighbours of particles covered here. Pairs that the particle loop
+// never lets conduct are kept apart with HeatGrid::group.
+void Simulation::ConductHeatGrid()
+{
+	for (int t = 0; t < PT_NUM; t++)
+	{
+		auto &el = elements[t];
+		heatGridRate[t] = 0.0f;
+		heatGridCapacity[t] = 1.0f;
+		if (el.Enabled && el.HeatConduct > 0 && !(el.Properties&TYPE_ENERGY))
+		{
+			heatGridRate[t] = std::min(el.HeatConduct/250.0f, 1.0f);
+#ifdef REALISTIC
+			heatGridCapacity[t] = 96.645f/el.HeatConduct*fabs(el.Weight);
+#endif
+		}
+	}
+
+	auto *T = heatGrid.temp.data();
+	auto *C = heatGrid.capacity.data();
+	auto *K = heatGrid.rate.data();
+	auto *G = heatGrid.group.data();
+	for (int y = 0; y < YRES; y++)
+	{
+		if (!pmapRowParts[y])
+		{
+			if (heatGrid.rowActive[y])
+				heatGrid.ClearRow(y);
+			continue;
+		}
+		heatGrid.rowActive[y] = true;
+		for (int x = 0; x < XRES; x++)
+		{
+			auto c = y*XRES+x;
+			auto r = pmap[y][x];
+			auto t = TYP(r);
+			float rate = 0.0f;
+			float capacity = 1.0f;
+			unsigned char group = 0;
+			if (t && !(bmap[y/CELL][x/CELL] == WL_STASIS && emap[y/CELL][x/CELL]<8))
+			{
+				auto &part = parts[ID(r)];
+				rate = heatGridRate[t];
+				capacity = heatGridCapacity[t];
+				if (t == PT_GEL)
+				{
+					float gel_scale = part.tmp*2.55f;
+					rate = std::min(int(elements[t].HeatConduct*gel_scale)/250.0f, 1.0f);
+#ifdef REALISTIC
+					capacity *= gel_scale;
+#endif
+				}
+				if (t == PT_HSWC && part.life != 10)
+					rate = 0.0f;
+				if (t == PT_FILT)
+					group = HeatGrid::groupFilt;
+				else if (t == PT_BRAY || t == PT_BIZR || t == PT_BIZRG || (t == PT_HSWC && part.tmp == 1))
+					group = HeatGrid::groupNoFilt;
+				if (!(rate > 0.0f && capacity > 0.0f))
+				{
+					rate = 0.0f;
+					capacity = 1.0f;
+				}
+				T[c] = part.temp;
+			}
+			K[c] = rate;
+			C[c] = capacity;
+			G[c] = group;
+		}
+	}
+
+	heatGrid.Conduct();
+
+	auto *next = heatGrid.nextTemp.data();
+	for (int y = CELL; y < YRES-CELL; y++)
+	{
+		if (!heatGrid.rowActive[y])
+			continue;
+		for (int x = CELL; x < XRES-CELL; x++)
+		{
+			auto c = y*XRES+x;
+			if (K[c] > 0.0f)
+			{
+				auto i = ID(pmap[y][x]);
+				parts[i].temp = restrict_flt(next[c], MIN_TEMP, MAX_TEMP);
+				heatGridTick[i] = currentTick;
+			}
+		}
+	}
+}
+
+// Call sites that draw from CounterRNG streams, so that they don't share streams.
+constexpr uint32_t rngSiteStaticParticle = 1;
+
+// Does what the serial loop in UpdateParticles would do to a motionless particle of a
+// type accepted by UpdateParticlesParallel, but only if that is limited to heat conduction
+// and the air cell under the particle. Anything else (sparks from walls, explosions,
+// state changes) is left to the serial loop: false is returned before anything is written.
+bool Simulation::UpdateStaticParticle(int i, CounterRNG &rng)
+{
+	auto &part = parts[i];
+	auto t = part.type;
+	auto &el = elements[t];
+	int x = (int)(part.x+0.5f);
+	int y = (int)(part.y+0.5f);
+
+	if (StaticParticleTriggered(part, x, y))
+		return false;
+
+	if (!rng.chance(el.HeatConduct, 250))
+	{
+		vx[y/CELL][x/CELL] = vx[y/CELL][x/CELL]*el.AirLoss + el.AirDrag*part.vx;
+		vy[y/CELL][x/CELL] = vy[y/CELL][x/CELL]*el.AirLoss + el.AirDrag*part.vy;
+		if (!(air->bmap_blockairh[y/CELL][x/CELL]&0x8))
+			air->bmap_blockairh[y/CELL][x/CELL]++;
+		part.temp = restrict_flt(part.temp, MIN_TEMP, MAX_TEMP);
+		return true;
+	}
+
+	auto temp = part.temp;
+	auto c_heat = 0.0f;
+	if (aheat_enable && !(el.Properties&PROP_NOAMBHEAT))
+	{
+		c_heat = (hv[y/CELL][x/CELL]-temp)*0.04;
+		c_heat = restrict_flt(c_heat, -MAX_TEMP+MIN_TEMP, MAX_TEMP-MIN_TEMP);
+		temp += c_heat;
+	}
+	int surround_hconduct[8];
+	int h_count = 0;
+	auto h_sum = 0.0f;
+	for (int nx=-1; nx<2; nx++)
+		for (int ny=-1; ny<2; ny++)
+		{
+			if (!nx && !ny)
+				continue;
+			auto r = pmap[y+ny][x+nx];
+			auto rt = TYP(r);
+			if (rt && elements[rt].HeatConduct && (rt!=PT_HSWC||parts[ID(r)].life==10) && !HeatGridConducted(i))
+			{
+				surround_hconduct[h_count] = ID(r);
+				h_sum += parts[ID(r)].temp;
+				h_count++;
+			}
+		}
+	auto pt = restrict_flt((h_sum+temp)/(h_count+1), MIN_TEMP, MAX_TEMP);
+	if (el.HighTemperatureTransition>-1 && pt>=el.HighTemperature)
+		return false;
+	if (el.LowTemperatureTransition>-1 && pt<el.LowTemperature)
+		return false;
+
+	vx[y/CELL][x/CELL] = vx[y/CELL][x/CELL]*el.AirLoss + el.AirDrag*part.vx;
+	vy[y/CELL][x/CELL] = vy[y/CELL][x/CELL]*el.AirLoss + el.AirDrag*part.vy;
+	hv[y/CELL][x/CELL] -= c_heat;
+	part.temp = pt;
+	for (int j = 0; j < h_count; j++)
+	{
+		parts[surround_hconduct[j]].temp = pt;
+	}
+	return true;
+}
+
+// Most particles in a typical save are solids that sit still and do nothing but
+// conduct heat. Those are updated here before the serial loop, in 32x32 tiles
+// spread over the worker pool. A particle only ever touches pixels next to it
+// and the air cell it is in, so tiles that don't share an edge or a corner can
+// be updated at the same time; the four phases of the checkerboard below ensure
+// exactly that. Each particle gets its own counter-based RNG stream, keyed by a
+// seed taken from the global RNG once per frame, the tick and the particle's ID,
+// so the result doesn't depend on the number of threads or on which tile a
+// particle is in, though it does differ from what a purely serial update would
+// produce.
+void Simulation::UpdateParticlesParallel()
+{
+	constexpr int tileSize = 8*CELL;
+	constexpr int tilesX = (XRES+tileSize-1)/tileSize;
+	constexpr int tilesY = (YRES+tileSize-1)/tileSize;
+
+	auto tileOf = [this](int i) {
+		auto &part = parts[i];
+		int x = (int)(part.x+0.5f);
+		int y = (int)(part.y+0.5f);
+		if (!IsStaticParticle(part, x, y) || (sleepingRegions && sleepMap.Asleep(x/CELL, y/CELL)))
+			return -1;
+		return (y/tileSize)*tilesX+(x/tileSize);
+	};
+
+	tileStart.assign(tilesX*tilesY+1, 0);
+	for (int i = 0; i <= parts_lastActiveIndex; i++)
+	{
+		auto tile = tileOf(i);
+		if (tile >= 0)
+			tileStart[tile+1]++;
+	}
+	for (int tile = 0; tile < tilesX*tilesY; tile++)
+	{
+		tileStart[tile+1] += tileStart[tile];
+	}
+	tileParts.resize(tileStart[tilesX*tilesY]);
+	{
+		auto tileEnd = tileStart;
+		for (int i = 0; i <= parts_lastActiveIndex; i++)
+		{
+			auto tile = tileOf(i);
+			if (tile >= 0)
+				tileParts[tileEnd[tile]++] = i;
+		}
+	}
+
+	auto frameSeed = RNG::Ref().gen();
+	for (int phase = 0; phase < 4; phase++)
+	{
+		auto offsetX = phase & 1;
+		auto offsetY = phase >> 1;
+		auto phaseTilesX = (tilesX-offsetX+1)/2;
+		auto phaseTilesY = (tilesY-offsetY+1)/2;
+		updatePool->ParallelFor(phaseTilesX*phaseTilesY, [this, offsetX, offsetY, phaseTilesX, frameSeed](int index) {
+			auto tile = (offsetY+2*(index/phaseTilesX))*tilesX+offsetX+2*(index%phaseTilesX);
+			for (int p = tileStart[tile]; p < tileStart[tile+1]; p++)
+			{
+				auto i = tileParts[p];
+				CounterRNG rng(frameSeed, currentTick, i, rngSiteStaticParticle);
+				if (UpdateStaticParticle(i, rng))
+					updatedInParallel[i] = 1;
+			}
+		});
+	}
+}
+
 void Simulation::UpdateParticles(int start, int end)
 {
+	SimulationProfiler::Scope profilerScope(profiler, SimulationProfiler::phaseUpdateParticles);
 	int i, j, x, y, t, nx, ny, r, surround_space, s, rt, nt;
 	float mv, dx, dy, nrx, nry, dp, ctemph, ctempl, gravtot;
 	int fin_x, fin_y, clear_x, clear_y, stagnant;
@@ -2302,10 +2686,25 @@ void Simulation::UpdateParticles(int start, int end)
 	int surround_hconduct[8];
 	bool transitionOccurred;
 
+	bool fullPass = start == 0 && end >= NPART && !legacy_enable;
+	bool sleepPass = fullPass && sleepingRegions;
+	bool parallelPass = false;
+	if (sleepPass || (fullPass && updatePool))
+		UpdateStaticTypes();
+#ifndef REALISTIC
+	if (fullPass && updatePool)
+	{
+		UpdateParticlesParallel();
+		parallelPass = true;
+	}
+#endif
+
 	//the main particle loop function, goes over all particles.
 	for (i = start; i < end && i <= parts_lastActiveIndex; i++)
 		if (parts[i].type)
 		{
+			if (parallelPass && updatedInParallel[i])
+				continue;
 			debug_mostRecentlyUpdated = i;
 			t = parts[i].type;
 
@@ -2319,6 +2718,17 @@ void Simulation::UpdateParticles(int start, int end)
 				continue;
 			}
 
+			// Skip static particles in regions where nothing has happened recently
+			if (sleepPass && sleepMap.Asleep(x/CELL, y/CELL) && CanSleep(parts[i], x, y))
+			{
+				// they'd still slow down air and block ambient heat
+				vx[y/CELL][x/CELL] = vx[y/CELL][x/CELL]*elements[t].AirLoss + elements[t].AirDrag*parts[i].vx;
+				vy[y/CELL][x/CELL] = vy[y/CELL][x/CELL]*elements[t].AirLoss + elements[t].AirDrag*parts[i].vy;
+				if (aheat_enable && !RNG::Ref().chance(elements[t].HeatConduct, 250) && !(air->bmap_blockairh[y/CELL][x/CELL]&0x8))
+					air->bmap_blockairh[y/CELL][x/CELL]++;
+				continue;
+			}
+
 			// Kill a particle in a wall where it isn't supposed to go
 			if (bmap[y/CELL][x/CELL] &&
 			   (bmap[y/CELL][x/CELL]==WL_WALL ||
@@ -2473,11 +2883,13 @@ void Simulation::UpdateParticles(int start, int end)
 #ifdef REALISTIC
 					float c_Cm = 0.0f;
 #endif
+					// ConductHeatGrid has already done this
+					bool gridConducted = HeatGridConducted(i);
 					for (j=0; j<8; j++)
 					{
 						surround_hconduct[j] = i;
 						r = surround[j];
-						if (!r)
+						if (!r || gridConducted)
 							continue;
 						rt = TYP(r);
 						if (rt && elements[rt].HeatConduct && (rt!=PT_HSWC||parts[ID(r)].life==10)
@@ -2626,6 +3038,7 @@ void Simulation::UpdateParticles(int start, int end)
 								{
 									t = PT_LAVA;
 									parts[i].type = PT_TUNG;
+									typeIndex.Add(i, PT_TUNG);
 								}
 							}
 							else if (ctemph >= elements[t].HighTemperature)
@@ -2904,7 +3317,14 @@ void Simulation::UpdateParticles(int start, int end)
 			//call the particle update function, if there is one
 			if (elements[t].Update)
 			{
-				if ((*(elements[t].Update))(this, i, x, y, surround_space, nt, parts, pmap))
+				int updateResult;
+				{
+					std::optional<SimulationProfiler::ElementScope> scope;
+					if (profiler.GetElementTiming())
+						scope.emplace(profiler, t, SimulationProfiler::functionUpdate);
+					updateResult = (*(elements[t].Update))(this, i, x, y, surround_space, nt, parts, pmap);
+				}
+				if (updateResult)
 					continue;
 				x = (int)(parts[i].x+0.5f);
 				y = (int)(parts[i].y+0.5f);
@@ -3059,19 +3479,13 @@ killed:
 				}
 				if (ny!=y || nx!=x)
 				{
-					if (ID(pmap[y][x]) == i)
-						pmap[y][x] = 0;
-					else if (ID(photons[y][x]) == i)
-						photons[y][x] = 0;
 					if (nx<CELL || nx>=XRES-CELL || ny<CELL || ny>=YRES-CELL)
 					{
 						kill_part(i);
 						continue;
 					}
-					if (elements[t].Properties & TYPE_ENERGY)
-						photons[ny][nx] = PMAP(i, t);
-					else if (t)
-						pmap[ny][nx] = PMAP(i, t);
+					if (t)
+						PmapAdd(i, nx, ny);
 				}
 			}
 			else if (elements[t].Properties & TYPE_ENERGY)
@@ -3451,22 +3865,250 @@ killed:
 movedone:
 			continue;
 		}
+	if (parallelPass)
+		std::fill(updatedInParallel.begin(), updatedInParallel.end(), 0);
+	if (sleepPass)
+		UpdateSleepMap();
 
 	//'f' was pressed (single frame)
 	if (framerender)
 		framerender--;
 }
 
+// Interleaves the bits of x and y, both less than 1 << 16.
+static uint32_t MortonCode(uint32_t x, uint32_t y)
+{
+	auto spread = [](uint32_t v) {
+		v = (v | (v << 8)) & 0x00FF00FFU;
+		v = (v | (v << 4)) & 0x0F0F0F0FU;
+		v = (v | (v << 2)) & 0x33333333U;
+		v = (v | (v << 1)) & 0x55555555U;
+		return v;
+	};
+	return spread(x) | (spread(y) << 1);
+}
+
+// Leaves pmap empty and the free list stale, callers are expected to call RecalcFreeParticles afterwards.
+void Simulation::CompactParticleSlots()
+{
+	compactOrder.clear();
+	for (int i = 0; i <= parts_lastActiveIndex; i++)
+	{
+		if (!parts[i].type)
+			continue;
+		auto x = std::clamp(int(parts[i].x + 0.5f), 0, XRES - 1);
+		auto y = std::clamp(int(parts[i].y + 0.5f), 0, YRES - 1);
+		// The old ID breaks ties, so stacked particles keep their relative update order
+		compactOrder.push_back((uint64_t(MortonCode(x, y)) << 32) | uint32_t(i));
+	}
+	std::sort(compactOrder.begin(), compactOrder.end());
+
+	int count = int(compactOrder.size());
+	compactIDs.assign(parts_lastActiveIndex + 1, -1);
+	compactParts.resize(count);
+	for (int j = 0; j < count; j++)
+	{
+		auto i = int(compactOrder[j] & 0xFFFFFFFFU);
+		compactIDs[i] = j;
+		compactParts[j] = parts[i];
+	}
+	auto newID = [this](int i) {
+		// Links to empty slots are left alone, like in Load
+		if (i >= 0 && i < int(compactIDs.size()) && compactIDs[i] >= 0)
+			return compactIDs[i];
+		return i;
+	};
+	for (auto &part : compactParts)
+	{
+		if (part.type == PT_SOAP)
+		{
+			if ((part.ctype & 0x2) == 2)
+				part.tmp = newID(part.tmp);
+			if ((part.ctype & 0x4) == 4)
+				part.tmp2 = newID(part.tmp2);
+		}
+	}
+	for (auto *stickman : { &player, &player2 })
+	{
+		if (stickman->spawnID >= 0)
+			stickman->spawnID = newID(stickman->spawnID);
+	}
+
+	std::copy(compactParts.begin(), compactParts.end(), parts);
+	// Slots past parts_lastActiveIndex are expected to be chained in order, see clear_sim
+	for (int i = count; i <= parts_lastActiveIndex; i++)
+	{
+		parts[i] = Particle();
+		parts[i].life = (i == NPART - 1) ? -1 : i + 1;
+		typeIndex.Remove(i);
+	}
+	parts_lastActiveIndex = count - 1;
+	// Particles have all changed IDs, so every one of them has to be entered again
+	ResetPmap();
+}
+
+void Simulation::CompactParticles()
+{
+	CompactParticleSlots();
+	RecalcFreeParticles(false);
+}
+
+static bool CountsForStacking(int t)
+{
+	// (there are a few exceptions, including energy particles - currently no limit on stacking those)
+	return t!=PT_THDR && t!=PT_EMBR && t!=PT_FIGH && t!=PT_PLSM;
+}
+
+void Simulation::PmapAdd(int i, int x, int y, bool onTop)
+{
+	PmapRemove(i);
+	auto t = parts[i].type;
+	auto &slot = pmapSlots[i];
+	slot.type = t;
+	slot.energy = elements[t].Properties & TYPE_ENERGY;
+	if (!InBounds(x, y))
+	{
+		return;
+	}
+	slot.cell = y * XRES + x;
+	slot.next = pmapHead[y][x];
+	pmapHead[y][x] = i;
+	pmapRowParts[y]++;
+	MarkPmapCell(x, y);
+	if (onTop)
+	{
+		if (slot.energy)
+			photons[y][x] = PMAP(i, t);
+		else
+			pmap[y][x] = PMAP(i, t);
+	}
+}
+
+void Simulation::PmapRemove(int i)
+{
+	auto &slot = pmapSlots[i];
+	if (slot.cell < 0)
+	{
+		return;
+	}
+	auto x = slot.cell % XRES;
+	auto y = slot.cell / XRES;
+	for (auto *link = &pmapHead[y][x]; *link >= 0; link = &pmapSlots[*link].next)
+	{
+		if (*link == i)
+		{
+			*link = slot.next;
+			break;
+		}
+	}
+	slot.cell = -1;
+	pmapRowParts[y]--;
+	MarkPmapCell(x, y);
+	if (ID(pmap[y][x]) == i)
+		pmap[y][x] = 0;
+	if (ID(photons[y][x]) == i)
+		photons[y][x] = 0;
+}
+
+// Brings every pixel marked since the last call back in line with the particles entered into
+// it, exactly as if pmap, photons and pmap_count had been rebuilt from scratch.
+void Simulation::RecalcPmapCells()
+{
+	for (auto cell : pmapChangedCells)
+	{
+		auto x = cell % XRES;
+		auto y = cell / XRES;
+		pmapChanged[y][x] = false;
+		pmapCellParts.clear();
+		for (auto i = pmapHead[y][x]; i >= 0; i = pmapSlots[i].next)
+			pmapCellParts.push_back(i);
+		// A full rebuild would visit them in index order
+		std::sort(pmapCellParts.begin(), pmapCellParts.end());
+		int top = 0, topPhoton = 0;
+		unsigned int count = 0;
+		for (auto i : pmapCellParts)
+		{
+			auto t = parts[i].type;
+			if (pmapSlots[i].energy)
+				topPhoton = PMAP(i, t);
+			else
+			{
+				// Particles are sometimes allowed to go inside INVS and FILT
+				// To make particles collide correctly when inside these elements, these elements must not overwrite an existing pmap entry from particles inside them
+				if (!top || (t!=PT_INVIS && t!= PT_FILT))
+					top = PMAP(i, t);
+				if (CountsForStacking(t))
+					count++;
+			}
+		}
+		pmap[y][x] = top;
+		photons[y][x] = topPhoton;
+		// see CheckStacking for the threshold
+		if (count > 5 && pmap_count[y][x] <= 5)
+			stackingCandidates.push_back(cell);
+		pmap_count[y][x] = count;
+	}
+	pmapChangedCells.clear();
+}
+
+void Simulation::ResetPmap()
+{
+	memset(pmap, 0, sizeof(pmap));
+	memset(photons, 0, sizeof(photons));
+	memset(pmap_count, 0, sizeof(pmap_count));
+	memset(pmapChanged, 0, sizeof(pmapChanged));
+	std::fill(&pmapHead[0][0], &pmapHead[0][0] + YRES * XRES, -1);
+	std::fill(pmapRowParts, pmapRowParts + YRES, 0);
+	for (auto &slot : pmapSlots)
+		slot.cell = -1;
+	pmapChangedCells.clear();
+	stackingCandidates.clear();
+}
+
+// Debug builds only: rebuilds the maps from scratch the way RecalcFreeParticles used to every
+// frame and checks that keeping them up to date incrementally got the same result.
+void Simulation::VerifyPmap()
+{
+	std::vector<int> fullPmap(YRES * XRES, 0), fullPhotons(YRES * XRES, 0);
+	std::vector<unsigned int> fullCount(YRES * XRES, 0U);
+	for (int i = 0; i <= parts_lastActiveIndex; i++)
+	{
+		auto t = parts[i].type;
+		if (!t)
+			continue;
+		auto x = int(parts[i].x + 0.5f);
+		auto y = int(parts[i].y + 0.5f);
+		if (!InBounds(x, y))
+			continue;
+		auto cell = y * XRES + x;
+		if (elements[t].Properties & TYPE_ENERGY)
+			fullPhotons[cell] = PMAP(i, t);
+		else
+		{
+			if (!fullPmap[cell] || (t!=PT_INVIS && t!= PT_FILT))
+				fullPmap[cell] = PMAP(i, t);
+			if (CountsForStacking(t))
+				fullCount[cell]++;
+		}
+	}
+	int mismatches = 0;
+	for (int y = 0; y < YRES; y++)
+	{
+		for (int x = 0; x < XRES; x++)
+		{
+			auto cell = y * XRES + x;
+			mismatches += (pmap[y][x] != fullPmap[cell] || photons[y][x] != fullPhotons[cell] || pmap_count[y][x] != fullCount[cell]);
+		}
+	}
+	assert(!mismatches);
+}
+
 void Simulation::RecalcFreeParticles(bool do_life_dec)
 {
 	int x, y, t;
 	int lastPartUsed = 0;
 	int lastPartUnused = -1;
 
-	memset(pmap, 0, sizeof(pmap));
-	memset(pmap_count, 0, sizeof(pmap_count));
-	memset(photons, 0, sizeof(photons));
-
 	NUM_PARTS = 0;
 	//the particle loop that resets the pmap/photon maps every frame, to update them.
 	for (int i = 0; i <= parts_lastActiveIndex; i++)
@@ -3476,25 +4118,16 @@ void Simulation::RecalcFreeParticles(bool do_life_dec)
 			t = parts[i].type;
 			x = (int)(parts[i].x+0.5f);
 			y = (int)(parts[i].y+0.5f);
-			bool inBounds = false;
-			if (x>=0 && y>=0 && x<XRES && y<YRES)
+			bool inBounds = x>=0 && y>=0 && x<XRES && y<YRES;
+			auto &slot = pmapSlots[i];
+			if (slot.cell != (inBounds ? y*XRES+x : -1) || slot.type != t || slot.energy != bool(elements[t].Properties & TYPE_ENERGY))
 			{
-				if (elements[t].Properties & TYPE_ENERGY)
-					photons[y][x] = PMAP(i, t);
-				else
-				{
-					// Particles are sometimes allowed to go inside INVS and FILT
-					// To make particles collide correctly when inside these elements, these elements must not overwrite an existing pmap entry from particles inside them
-					if (!pmap[y][x] || (t!=PT_INVIS && t!= PT_FILT))
-						pmap[y][x] = PMAP(i, t);
-					// (there are a few exceptions, including energy particles - currently no limit on stacking those)
-					if (t!=PT_THDR && t!=PT_EMBR && t!=PT_FIGH && t!=PT_PLSM)
-						pmap_count[y][x]++;
-				}
-				inBounds = true;
+				// moved or changed type without going through PmapAdd, e.g. from Lua or by copying a particle over it
+				PmapAdd(i, x, y, false);
 			}
 			lastPartUsed = i;
 			NUM_PARTS ++;
+			typeIndex.Add(i, t);
 
 			if (elementRecount && t >= 0 && t < PT_NUM && elements[t].Enabled)
 				elementCount[t]++;
@@ -3530,6 +4163,8 @@ void Simulation::RecalcFreeParticles(bool do_life_dec)
 		}
 		else
 		{
+			typeIndex.Remove(i);
+			PmapRemove(i);
 			if (lastPartUnused<0) pfree = i;
 			else parts[lastPartUnused].life = i;
 			lastPartUnused = i;
@@ -3544,6 +4179,12 @@ void Simulation::RecalcFreeParticles(bool do_life_dec)
 		parts[lastPartUnused].life = (parts_lastActiveIndex>=(NPART-1)) ? -1 : parts_lastActiveIndex+1;
 	}
 	parts_lastActiveIndex = lastPartUsed;
+	RecalcPmapCells();
+	if constexpr (DEBUG)
+	{
+		VerifyPmap();
+	}
+	spatialIndex.Invalidate();
 	if (elementRecount)
 		elementRecount = false;
 }
@@ -3551,7 +4192,15 @@ void Simulation::RecalcFreeParticles(bool do_life_dec)
 void Simulation::SimulateGoL()
 {
 	CGOL = 0;
-	for (int i = 0; i <= parts_lastActiveIndex; ++i)
+	// The neighbour lists below depend on the order in which LIFE particles are visited
+	typeIndex.Sort(PT_LIFE);
+	auto &contributors = golMap.contributors;
+	contributors.clear();
+	// * If every contributing cell is of the same kind and no two of them share a pixel,
+	//   neighbour lists would only ever have one entry, so only the count is needed.
+	bool singleKind = true;
+	unsigned int singleGolnum = 0;
+	for (auto i : typeIndex.Get(PT_LIFE))
 	{
 		auto &part = parts[i];
 		if (part.type != PT_LIFE)
@@ -3564,6 +4213,7 @@ void Simulation::SimulateGoL()
 		{
 			continue;
 		}
+		golMap.MarkTile(x, y);
 		unsigned int golnum = part.ctype;
 		unsigned int ruleset = golnum;
 		if (golnum < NGOL)
@@ -3573,78 +4223,126 @@ void Simulation::SimulateGoL()
 		}
 		if (part.tmp2 == int((ruleset >> 17) & 0xF) + 1)
 		{
-			for (int yy = -1; yy <= 1; ++yy)
+			if (contributors.empty())
+			{
+				singleGolnum = golnum;
+			}
+			if (golnum != singleGolnum || golnum > 0x001FFFFFU || ID(pmap[y][x]) != i)
+			{
+				singleKind = false;
+			}
+			contributors.push_back(i);
+		}
+		else
+		{
+			if (!(bmap[y / CELL][x / CELL] == WL_STASIS && emap[y / CELL][x / CELL] < 8))
 			{
-				for (int xx = -1; xx <= 1; ++xx)
+				part.tmp2 -= 1;
+			}
+		}
+	}
+	golMap.BuildSpans();
+	for (auto i : contributors)
+	{
+		auto &part = parts[i];
+		auto x = int(part.x + 0.5f);
+		auto y = int(part.y + 0.5f);
+		if (singleKind)
+		{
+			golMap.SetAlive(x, y);
+			continue;
+		}
+		unsigned int golnum = part.ctype;
+		if (golnum < NGOL)
+		{
+			golnum += 1;
+		}
+		for (int yy = -1; yy <= 1; ++yy)
+		{
+			for (int xx = -1; xx <= 1; ++xx)
+			{
+				if (xx || yy)
 				{
-					if (xx || yy)
+					// * Calculate address of the neighbourList, taking wraparound
+					//   into account. The fact that the GOL space is 2 CELL's worth
+					//   narrower in both dimensions than the simulation area makes
+					//   this a bit awkward.
+					int ax = ((x + xx + XRES - 3 * CELL) % (XRES - 2 * CELL)) + CELL;
+					int ay = ((y + yy + YRES - 3 * CELL) % (YRES - 2 * CELL)) + CELL;
+					if (pmap[ay][ax] && TYP(pmap[ay][ax]) != PT_LIFE)
 					{
-						// * Calculate address of the neighbourList, taking wraparound
-						//   into account. The fact that the GOL space is 2 CELL's worth
-						//   narrower in both dimensions than the simulation area makes
-						//   this a bit awkward.
-						int ax = ((x + xx + XRES - 3 * CELL) % (XRES - 2 * CELL)) + CELL;
-						int ay = ((y + yy + YRES - 3 * CELL) % (YRES - 2 * CELL)) + CELL;
-						if (pmap[ay][ax] && TYP(pmap[ay][ax]) != PT_LIFE)
+						continue;
+					}
+					auto &neighbourList = golMap.List(ax, ay);
+					// * Bump overall neighbour counter (bits 30..28) for the entire list.
+					neighbourList[0] += 1U << 28;
+					for (int l = 0; l < 5; ++l)
+					{
+						auto neighbourRuleset = neighbourList[l] & 0x001FFFFFU;
+						if (neighbourRuleset == golnum)
 						{
-							continue;
+							// * Bump population counter (bits 23..21) of the
+							//   same kind of cell.
+							neighbourList[l] += 1U << 21;
+							break;
 						}
-						unsigned int (&neighbourList)[5] = gol[ay][ax];
-						// * Bump overall neighbour counter (bits 30..28) for the entire list.
-						neighbourList[0] += 1U << 28;
-						for (int l = 0; l < 5; ++l)
+						if (neighbourRuleset == 0)
 						{
-							auto neighbourRuleset = neighbourList[l] & 0x001FFFFFU;
-							if (neighbourRuleset == golnum)
-							{
-								// * Bump population counter (bits 23..21) of the
-								//   same kind of cell.
-								neighbourList[l] += 1U << 21;
-								break;
-							}
-							if (neighbourRuleset == 0)
-							{
-								// * Add the new kind of cell to the population. Both counters
-								//   have a bias of -1, so they're intentionally initialised
-								//   to 0 instead of 1 here. This is all so they can both
-								//   fit in 3 bits.
-								neighbourList[l] = ((yy & 3) << 26) | ((xx & 3) << 24) | golnum;
-								break;
-							}
-							// * If after 5 iterations the cell still hasn't contributed
-							//   to a list entry, it's surely a 6th kind of cell, meaning
-							//   there could be at most 3 of it in the neighbourhood,
-							//   as there are already 5 other kinds of cells present in
-							//   the list. This in turn means that it couldn't possibly
-							//   win the population ratio-based contest later on.
+							// * Add the new kind of cell to the population. Both counters
+							//   have a bias of -1, so they're intentionally initialised
+							//   to 0 instead of 1 here. This is all so they can both
+							//   fit in 3 bits.
+							neighbourList[l] = ((yy & 3) << 26) | ((xx & 3) << 24) | golnum;
+							break;
 						}
+						// * If after 5 iterations the cell still hasn't contributed
+						//   to a list entry, it's surely a 6th kind of cell, meaning
+						//   there could be at most 3 of it in the neighbourhood,
+						//   as there are already 5 other kinds of cells present in
+						//   the list. This in turn means that it couldn't possibly
+						//   win the population ratio-based contest later on.
 					}
 				}
 			}
 		}
-		else
-		{
-			if (!(bmap[y / CELL][x / CELL] == WL_STASIS && emap[y / CELL][x / CELL] < 8))
-			{
-				part.tmp2 -= 1;
-			}
-		}
 	}
+	unsigned char neighbourCounts[XRES];
 	for (int y = CELL; y < YRES - CELL; ++y)
 	{
-		for (int x = CELL; x < XRES - CELL; ++x)
+		for (auto &span : golMap.Spans(y))
 		{
-			int r = pmap[y][x];
-			if (r && TYP(r) != PT_LIFE)
+			if (singleKind)
 			{
-				continue;
+				golMap.CountNeighbours(y, span.begin, span.end, neighbourCounts);
 			}
-			unsigned int (&neighbourList)[5] = gol[y][x];
-			auto nl0 = neighbourList[0];
-			if (r || nl0)
+			for (int x = span.begin; x < span.end; ++x)
 			{
-				// * Get overall neighbour count (bits 30..28).
-				unsigned int neighbours = nl0 ? ((nl0 >> 28) & 7) + 1 : 0;
+				int r = pmap[y][x];
+				if (r && TYP(r) != PT_LIFE)
+				{
+					continue;
+				}
+				GolMap::NeighbourList *neighbourList = nullptr;
+				unsigned int neighbours;
+				if (singleKind)
+				{
+					neighbours = neighbourCounts[x];
+					if (!(r || neighbours))
+					{
+						continue;
+					}
+				}
+				else
+				{
+					neighbourList = golMap.FindList(x, y);
+					auto nl0 = neighbourList ? (*neighbourList)[0] : 0U;
+					if (!(r || nl0))
+					{
+						continue;
+					}
+					// * Get overall neighbour count (bits 30..28).
+					neighbours = nl0 ? ((nl0 >> 28) & 7) + 1 : 0;
+				}
 				if (!(bmap[y / CELL][x / CELL] == WL_STASIS && emap[y / CELL][x / CELL] < 8))
 				{
 					if (r)
@@ -3665,24 +4363,43 @@ void Simulation::SimulateGoL()
 					{
 						unsigned int golnumToCreate = 0xFFFFFFFFU;
 						unsigned int createFromEntry = 0U;
-						unsigned int majority = neighbours / 2 + neighbours % 2;
-						for (int l = 0; l < 5; ++l)
+						if (singleKind)
 						{
-							auto golnum = neighbourList[l] & 0x001FFFFFU;
-							if (!golnum)
-							{
-								break;
-							}
+							// * The only kind of cell around is always in the majority.
+							auto golnum = singleGolnum;
 							auto ruleset = golnum;
 							if (golnum - 1 < NGOL)
 							{
 								ruleset = builtinGol[golnum - 1].ruleset;
 								golnum -= 1;
 							}
-							if ((ruleset >> (neighbours + 8)) & 1 && ((neighbourList[l] >> 21) & 7) + 1 >= majority && golnum < golnumToCreate)
+							if ((ruleset >> (neighbours + 8)) & 1)
 							{
 								golnumToCreate = golnum;
-								createFromEntry = neighbourList[l];
+							}
+						}
+						else
+						{
+							auto &list = *neighbourList;
+							unsigned int majority = neighbours / 2 + neighbours % 2;
+							for (int l = 0; l < 5; ++l)
+							{
+								auto golnum = list[l] & 0x001FFFFFU;
+								if (!golnum)
+								{
+									break;
+								}
+								auto ruleset = golnum;
+								if (golnum - 1 < NGOL)
+								{
+									ruleset = builtinGol[golnum - 1].ruleset;
+									golnum -= 1;
+								}
+								if ((ruleset >> (neighbours + 8)) & 1 && ((list[l] >> 21) & 7) + 1 >= majority && golnum < golnumToCreate)
+								{
+									golnumToCreate = golnum;
+									createFromEntry = list[l];
+								}
 							}
 						}
 						if (golnumToCreate != 0xFFFFFFFFU)
@@ -3691,12 +4408,36 @@ void Simulation::SimulateGoL()
 							int i = create_part(-1, x, y, PT_LIFE, golnumToCreate | 0x200000);
 							if (i >= 0)
 							{
-								int xx = (createFromEntry >> 24) & 3;
-								int yy = (createFromEntry >> 26) & 3;
-								if (xx == 3) xx = -1;
-								if (yy == 3) yy = -1;
-								int ax = ((x - xx + XRES - 3 * CELL) % (XRES - 2 * CELL)) + CELL;
-								int ay = ((y - yy + YRES - 3 * CELL) % (YRES - 2 * CELL)) + CELL;
+								int ax = x, ay = y;
+								if (singleKind)
+								{
+									// * Take after the neighbour that would have started the
+									//   neighbour list, the one with the lowest ID.
+									int sampleId = -1;
+									for (int yy = -1; yy <= 1; ++yy)
+									{
+										for (int xx = -1; xx <= 1; ++xx)
+										{
+											int nx = ((x + xx + XRES - 3 * CELL) % (XRES - 2 * CELL)) + CELL;
+											int ny = ((y + yy + YRES - 3 * CELL) % (YRES - 2 * CELL)) + CELL;
+											if ((xx || yy) && golMap.Alive(nx, ny) && (sampleId < 0 || ID(pmap[ny][nx]) < sampleId))
+											{
+												sampleId = ID(pmap[ny][nx]);
+												ax = nx;
+												ay = ny;
+											}
+										}
+									}
+								}
+								else
+								{
+									int xx = (createFromEntry >> 24) & 3;
+									int yy = (createFromEntry >> 26) & 3;
+									if (xx == 3) xx = -1;
+									if (yy == 3) yy = -1;
+									ax = ((x - xx + XRES - 3 * CELL) % (XRES - 2 * CELL)) + CELL;
+									ay = ((y - yy + YRES - 3 * CELL) % (YRES - 2 * CELL)) + CELL;
+								}
 								auto &sample = parts[ID(pmap[ay][ax])];
 								parts[i].dcolour = sample.dcolour;
 								parts[i].tmp = sample.tmp;
@@ -3704,21 +4445,31 @@ void Simulation::SimulateGoL()
 						}
 					}
 				}
-				for (int l = 0; l < 5 && neighbourList[l]; ++l)
+				if (neighbourList)
 				{
-					neighbourList[l] = 0;
+					for (int l = 0; l < 5 && (*neighbourList)[l]; ++l)
+					{
+						(*neighbourList)[l] = 0;
+					}
 				}
 			}
 		}
 	}
+	if (singleKind)
+	{
+		golMap.ClearAlive();
+	}
 	for (int y = CELL; y < YRES - CELL; ++y)
 	{
-		for (int x = CELL; x < XRES - CELL; ++x)
+		for (auto &span : golMap.Spans(y))
 		{
-			int r = pmap[y][x];
-			if (r && TYP(r) == PT_LIFE && parts[ID(r)].tmp2 <= 0)
+			for (int x = span.begin; x < span.end; ++x)
 			{
-				kill_part(ID(r));
+				int r = pmap[y][x];
+				if (r && TYP(r) == PT_LIFE && parts[ID(r)].tmp2 <= 0)
+				{
+					kill_part(ID(r));
+				}
 			}
 		}
 	}
@@ -3726,34 +4477,40 @@ void Simulation::SimulateGoL()
 
 void Simulation::CheckStacking()
 {
-	bool excessive_stacking_found = false;
 	force_stacking_check = false;
-	for (int y = 0; y < YRES; y++)
+	// Visit candidates in the order a scan of the whole of pmap_count would, so random
+	// numbers are drawn for the same cells in the same order.
+	std::sort(stackingCandidates.begin(), stackingCandidates.end());
+	stackingCandidates.erase(std::unique(stackingCandidates.begin(), stackingCandidates.end()), stackingCandidates.end());
+	stackingCandidates.erase(std::remove_if(stackingCandidates.begin(), stackingCandidates.end(), [this](int index) {
+		return pmap_count[index / XRES][index % XRES] <= 5;
+	}), stackingCandidates.end());
+	// Cells where BHOL will form and the strength of their grav field, in the same order
+	excessiveStacking.clear();
+	excessiveStackingStrength.clear();
+	for (auto index : stackingCandidates)
 	{
-		for (int x = 0; x < XRES; x++)
+		int y = index / XRES;
+		int x = index % XRES;
+		// Use a threshold, since some particle stacking can be normal (e.g. BIZR + FILT)
+		auto count = pmap_count[y][x];
+		bool excessive;
+		if (bmap[y/CELL][x/CELL]==WL_EHOLE)
 		{
-			// Use a threshold, since some particle stacking can be normal (e.g. BIZR + FILT)
-			// Setting pmap_count[y][x] > NPART means BHOL will form in that spot
-			if (pmap_count[y][x]>5)
-			{
-				if (bmap[y/CELL][x/CELL]==WL_EHOLE)
-				{
-					// Allow more stacking in E-hole
-					if (pmap_count[y][x]>1500)
-					{
-						pmap_count[y][x] = pmap_count[y][x] + NPART;
-						excessive_stacking_found = 1;
-					}
-				}
-				else if (pmap_count[y][x]>1500 || (unsigned int)RNG::Ref().between(0, 1599) <= (pmap_count[y][x]+100))
-				{
-					pmap_count[y][x] = pmap_count[y][x] + NPART;
-					excessive_stacking_found = true;
-				}
-			}
+			// Allow more stacking in E-hole
+			excessive = count>1500;
+		}
+		else
+		{
+			excessive = count>1500 || (unsigned int)RNG::Ref().between(0, 1599) <= (count+100);
+		}
+		if (excessive)
+		{
+			excessiveStacking.push_back(index);
+			excessiveStackingStrength.push_back(std::min(count, 51200U));
 		}
 	}
-	if (excessive_stacking_found)
+	if (!excessiveStacking.empty())
 	{
 		for (int i = 0; i <= parts_lastActiveIndex; i++)
 		{
@@ -3764,15 +4521,17 @@ void Simulation::CheckStacking()
 				int y = (int)(parts[i].y+0.5f);
 				if (x>=0 && y>=0 && x<XRES && y<YRES && !(elements[t].Properties&TYPE_ENERGY))
 				{
-					if (pmap_count[y][x]>=NPART)
+					auto it = std::lower_bound(excessiveStacking.begin(), excessiveStacking.end(), y*XRES+x);
+					if (it != excessiveStacking.end() && *it == y*XRES+x)
 					{
-						if (pmap_count[y][x]>NPART)
+						auto &strength = excessiveStackingStrength[it - excessiveStacking.begin()];
+						// The first particle in the cell becomes the BHOL, the rest are killed
+						if (strength)
 						{
 							create_part(i, x, y, PT_NBHL);
 							parts[i].temp = MAX_TEMP;
-							parts[i].tmp = pmap_count[y][x]-NPART;//strength of grav field
-							if (parts[i].tmp>51200) parts[i].tmp = 51200;
-							pmap_count[y][x] = NPART;
+							parts[i].tmp = strength;//strength of grav field
+							strength = 0;
 						}
 						else
 						{
@@ -3785,18 +4544,128 @@ void Simulation::CheckStacking()
 	}
 }
 
+void Simulation::UpdateLoveLolz()
+{
+	// Only pixels with LOVE or LOLZ on top and 9x9 blocks with such pixels in them are visited,
+	// in the same order a scan of the whole of pmap would visit them, so particles are
+	// killed and created in the same order.
+	loveLolzCells.clear();
+	for (auto t : { PT_LOVE, PT_LOLZ })
+	{
+		for (auto i : typeIndex.Get(t))
+		{
+			int x = int(parts[i].x + 0.5f);
+			int y = int(parts[i].y + 0.5f);
+			if (x >= 0 && y >= 0 && x < XRES - 4 && y < YRES - 4 && pmap[y][x] && ID(pmap[y][x]) == i)
+			{
+				loveLolzCells.push_back(y * XRES + x);
+			}
+		}
+	}
+	std::sort(loveLolzCells.begin(), loveLolzCells.end());
+	loveLolzBlocks.clear();
+	for (auto index : loveLolzCells)
+	{
+		int ny = index / XRES;
+		int nx = index % XRES;
+		int r = pmap[ny][nx];
+		if (!r)
+		{
+			continue;
+		}
+		else if ((ny<9||nx<9||ny>YRES-7||nx>XRES-10)&&(parts[ID(r)].type==PT_LOVE||parts[ID(r)].type==PT_LOLZ))
+			kill_part(ID(r));
+		else if (parts[ID(r)].type==PT_LOVE || parts[ID(r)].type==PT_LOLZ)
+		{
+			if (!Element_LOVE_love[nx/9][ny/9] && !Element_LOLZ_lolz[nx/9][ny/9])
+			{
+				loveLolzBlocks.push_back(nx/9*(YRES/9)+ny/9);
+			}
+			if (parts[ID(r)].type==PT_LOVE)
+				Element_LOVE_love[nx/9][ny/9] = 1;
+			else
+				Element_LOLZ_lolz[nx/9][ny/9] = 1;
+		}
+	}
+	// Blocks are applied at their top left corner, x major, as the whole-map scan used to do.
+	std::sort(loveLolzBlocks.begin(), loveLolzBlocks.end());
+	for (auto block : loveLolzBlocks)
+	{
+		int nx = block / (YRES/9) * 9;
+		int ny = block % (YRES/9) * 9;
+		int nnx, nny, rt;
+		if (Element_LOVE_love[nx/9][ny/9]==1)
+		{
+			for ( nnx=0; nnx<9; nnx++)
+				for ( nny=0; nny<9; nny++)
+				{
+					if (ny+nny>0&&ny+nny<YRES&&nx+nnx>=0&&nx+nnx<XRES)
+					{
+						rt=pmap[ny+nny][nx+nnx];
+						if (!rt&&Element_LOVE_RuleTable[nnx][nny]==1)
+							create_part(-1,nx+nnx,ny+nny,PT_LOVE);
+						else if (!rt)
+							continue;
+						else if (parts[ID(rt)].type==PT_LOVE&&Element_LOVE_RuleTable[nnx][nny]==0)
+							kill_part(ID(rt));
+					}
+				}
+		}
+		Element_LOVE_love[nx/9][ny/9]=0;
+		if (Element_LOLZ_lolz[nx/9][ny/9]==1)
+		{
+			for ( nnx=0; nnx<9; nnx++)
+				for ( nny=0; nny<9; nny++)
+				{
+					if (ny+nny>0&&ny+nny<YRES&&nx+nnx>=0&&nx+nnx<XRES)
+					{
+						rt=pmap[ny+nny][nx+nnx];
+						if (!rt&&Element_LOLZ_RuleTable[nny][nnx]==1)
+							create_part(-1,nx+nnx,ny+nny,PT_LOLZ);
+						else if (!rt)
+							continue;
+						else if (parts[ID(rt)].type==PT_LOLZ&&Element_LOLZ_RuleTable[nny][nnx]==0)
+							kill_part(ID(rt));
+
+					}
+				}
+		}
+		Element_LOLZ_lolz[nx/9][ny/9]=0;
+	}
+}
+
 //updates pmap, gol, and some other simulation stuff (but not particles)
 void Simulation::BeforeSim()
 {
+	profiler.Commit();
+	SimulationProfiler::Scope beforeSimScope(profiler, SimulationProfiler::phaseBeforeSim);
+	heatGridPass = false;
+
 	if (!sys_pause||framerender)
 	{
-		air->update_air();
+		if (air->IsPipelined())
+		{
+			// collects last frame's air and ambient heat update and starts this frame's
+			SimulationProfiler::Scope scope(profiler, SimulationProfiler::phaseAir);
+			air->UpdatePipelined(aheat_enable);
+		}
+		else
+		{
+			{
+				SimulationProfiler::Scope scope(profiler, SimulationProfiler::phaseAir);
+				air->update_air();
+			}
 
-		if(aheat_enable)
-			air->update_airh();
+			if(aheat_enable)
+			{
+				SimulationProfiler::Scope scope(profiler, SimulationProfiler::phaseAirHeat);
+				air->update_airh();
+			}
+		}
 
 		if(grav->IsEnabled())
 		{
+			SimulationProfiler::Scope scope(profiler, SimulationProfiler::phaseGravity);
 			grav->gravity_update_async();
 
 			//Get updated buffer pointers for gravity
@@ -3823,12 +4692,20 @@ void Simulation::BeforeSim()
 
 	if (gravWallChanged)
 	{
+		SimulationProfiler::Scope scope(profiler, SimulationProfiler::phaseGravityMask);
 		grav->gravity_mask();
 		gravWallChanged = false;
 	}
 
 	if (debug_nextToUpdate == 0)
+	{
+		SimulationProfiler::Scope scope(profiler, SimulationProfiler::phaseRecalcFree);
+		if ((!sys_pause || framerender) && compactInterval > 0 && !(currentTick % compactInterval))
+		{
+			CompactParticleSlots();
+		}
 		RecalcFreeParticles(true);
+	}
 
 	if (!sys_pause || framerender)
 	{
@@ -3848,99 +4725,37 @@ void Simulation::BeforeSim()
 		// check for stacking and create BHOL if found
 		if (force_stacking_check || RNG::Ref().chance(1, 10))
 		{
+			SimulationProfiler::Scope scope(profiler, SimulationProfiler::phaseStacking);
 			CheckStacking();
 		}
 
 		// LOVE and LOLZ element handling
 		if (elementCount[PT_LOVE] > 0 || elementCount[PT_LOLZ] > 0)
 		{
-			int nx, nnx, ny, nny, r, rt;
-			for (ny=0; ny<YRES-4; ny++)
-			{
-				for (nx=0; nx<XRES-4; nx++)
-				{
-					r=pmap[ny][nx];
-					if (!r)
-					{
-						continue;
-					}
-					else if ((ny<9||nx<9||ny>YRES-7||nx>XRES-10)&&(parts[ID(r)].type==PT_LOVE||parts[ID(r)].type==PT_LOLZ))
-						kill_part(ID(r));
-					else if (parts[ID(r)].type==PT_LOVE)
-					{
-						Element_LOVE_love[nx/9][ny/9] = 1;
-					}
-					else if (parts[ID(r)].type==PT_LOLZ)
-					{
-						Element_LOLZ_lolz[nx/9][ny/9] = 1;
-					}
-				}
-			}
-			for (nx=9; nx<=XRES-18; nx++)
-			{
-				for (ny=9; ny<=YRES-7; ny++)
-				{
-					if (Element_LOVE_love[nx/9][ny/9]==1)
-					{
-						for ( nnx=0; nnx<9; nnx++)
-							for ( nny=0; nny<9; nny++)
-							{
-								if (ny+nny>0&&ny+nny<YRES&&nx+nnx>=0&&nx+nnx<XRES)
-								{
-									rt=pmap[ny+nny][nx+nnx];
-									if (!rt&&Element_LOVE_RuleTable[nnx][nny]==1)
-										create_part(-1,nx+nnx,ny+nny,PT_LOVE);
-									else if (!rt)
-										continue;
-									else if (parts[ID(rt)].type==PT_LOVE&&Element_LOVE_RuleTable[nnx][nny]==0)
-										kill_part(ID(rt));
-								}
-							}
-					}
-					Element_LOVE_love[nx/9][ny/9]=0;
-					if (Element_LOLZ_lolz[nx/9][ny/9]==1)
-					{
-						for ( nnx=0; nnx<9; nnx++)
-							for ( nny=0; nny<9; nny++)
-							{
-								if (ny+nny>0&&ny+nny<YRES&&nx+nnx>=0&&nx+nnx<XRES)
-								{
-									rt=pmap[ny+nny][nx+nnx];
-									if (!rt&&Element_LOLZ_RuleTable[nny][nnx]==1)
-										create_part(-1,nx+nnx,ny+nny,PT_LOLZ);
-									else if (!rt)
-										continue;
-									else if (parts[ID(rt)].type==PT_LOLZ&&Element_LOLZ_RuleTable[nny][nnx]==0)
-										kill_part(ID(rt));
-
-								}
-							}
-					}
-					Element_LOLZ_lolz[nx/9][ny/9]=0;
-				}
-			}
+			SimulationProfiler::Scope scope(profiler, SimulationProfiler::phaseLoveLolz);
+			UpdateLoveLolz();
 		}
 
 		// make WIRE work
 		if(elementCount[PT_WIRE] > 0)
 		{
-			for (int nx = 0; nx < XRES; nx++)
+			SimulationProfiler::Scope scope(profiler, SimulationProfiler::phaseWire);
+			// only WIRE that is in pmap, stacked WIRE underneath doesn't get updated
+			for (auto i : typeIndex.Get(PT_WIRE))
 			{
-				for (int ny = 0; ny < YRES; ny++)
-				{
-					int r = pmap[ny][nx];
-					if (!r)
-						continue;
-					if(parts[ID(r)].type == PT_WIRE)
-						parts[ID(r)].tmp = parts[ID(r)].ctype;
-				}
+				if (parts[i].type != PT_WIRE)
+					continue;
+				int x = int(parts[i].x + 0.5f);
+				int y = int(parts[i].y + 0.5f);
+				if (InBounds(x, y) && ID(pmap[y][x]) == i)
+					parts[i].tmp = parts[i].ctype;
 			}
 		}
 
 		// update PPIP tmp?
 		if (Element_PPIP_ppip_changed)
 		{
-			for (int i = 0; i <= parts_lastActiveIndex; i++)
+			for (auto i : typeIndex.Get(PT_PPIP))
 			{
 				if (parts[i].type==PT_PPIP)
 				{
@@ -3955,9 +4770,17 @@ void Simulation::BeforeSim()
 		// GSPEED is frames per generation
 		if (elementCount[PT_LIFE]>0 && ++CGOL>=GSPEED)
 		{
+			SimulationProfiler::Scope scope(profiler, SimulationProfiler::phaseGol);
 			SimulateGoL();
 		}
 
+		if (heatGridEnabled && !legacy_enable)
+		{
+			SimulationProfiler::Scope scope(profiler, SimulationProfiler::phaseHeatGrid);
+			ConductHeatGrid();
+			heatGridPass = true;
+		}
+
 		// wifi channel reseting
 		if (ISWIRE > 0)
 		{
@@ -3981,6 +4804,7 @@ void Simulation::BeforeSim()
 
 void Simulation::AfterSim()
 {
+	SimulationProfiler::Scope scope(profiler, SimulationProfiler::phaseAfterSim);
 	debug_mostRecentlyUpdated = -1;
 
 	if (emp_trigger_count)
@@ -4011,6 +4835,7 @@ Simulation::Simulation():
 	gravWallChanged(false),
 	CGOL(0),
 	GSPEED(1),
+	spatialIndex(typeIndex, parts),
 	edgeMode(0),
 	gravityMode(0),
 	customGravityX(0),
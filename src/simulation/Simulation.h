@@ -10,6 +10,12 @@
 #include "gravity/GravityPtr.h"
 #include "Element.h"
 #include "SimulationConfig.h"
+#include "SimulationProfiler.h"
+#include "SleepMap.h"
+#include "SpatialIndex.h"
+#include "GolMap.h"
+#include "HeatGrid.h"
+#include "TypeIndex.h"
 #include <cstring>
 #include <cstddef>
 #include <vector>
@@ -31,6 +37,9 @@ class Renderer;
 class Gravity;
 class Air;
 class GameSave;
+class WorkerPool;
+class RNGType;
+class CounterRNG;
 
 class Simulation
 {
@@ -72,6 +81,7 @@ public:
 	playerst fighters[MAX_FIGHTERS]; //Defined in Stickman.h
 	unsigned char fighcount; //Contains the number of fighters
 	bool gravWallChanged;
+	SimulationProfiler profiler;
 	//Portals and Wifi
 	Particle portalp[CHANNELS][8][80];
 	int portal_rx[8];
@@ -80,7 +90,7 @@ public:
 	//Gol sim
 	int CGOL;
 	int GSPEED;
-	unsigned int gol[YRES][XRES][5];
+	GolMap golMap;
 	//Air sim
 	float (*vx)[XCELLS];
 	float (*vy)[XCELLS];
@@ -98,9 +108,34 @@ public:
 	float fvy[YCELLS][XCELLS];
 	//Particles
 	Particle parts[NPART];
+	TypeIndex typeIndex;
+	SpatialIndex spatialIndex;
 	int pmap[YRES][XRES];
 	int photons[YRES][XRES];
+	// How many particles that count towards stacking are in each pixel, see CheckStacking.
 	unsigned int pmap_count[YRES][XRES];
+	// Writes to pmap and photons must go through these, so that the pixel is brought back in
+	// line with the particles in it by the next RecalcFreeParticles, see RecalcPmapCells.
+	void SetPmap(int x, int y, int value)
+	{
+		pmap[y][x] = value;
+		MarkPmapCell(x, y);
+	}
+	void SetPhotons(int x, int y, int value)
+	{
+		photons[y][x] = value;
+		MarkPmapCell(x, y);
+	}
+	// Anything that moves a particle, creates or kills one, or changes its type enters it into
+	// its new pixel with PmapAdd or takes it out of its old one with PmapRemove. PmapAdd takes
+	// the particle out of wherever it was first, and puts it on top of pmap or photons unless
+	// onTop is false, in which case it only shows up there from the next RecalcFreeParticles.
+	void PmapAdd(int i, int x, int y, bool onTop = true);
+	void PmapRemove(int i);
+	// y * XRES + x of every cell whose pmap_count went over the stacking threshold, so
+	// CheckStacking doesn't have to scan all of pmap_count. May list a cell more than once,
+	// or cells that have since gone back under the threshold, CheckStacking tidies it up.
+	std::vector<int> stackingCandidates;
 	//Simulation Settings
 	int edgeMode;
 	int gravityMode;
@@ -125,6 +160,8 @@ public:
 
 	std::unique_ptr<Snapshot> CreateSnapshot();
 	void Restore(const Snapshot &snap);
+	// The Snapshot last created or restored, CreateSnapshot shares its unchanged tiles.
+	std::unique_ptr<Snapshot> lastSnapshot;
 
 	int is_blocking(int t, int x, int y);
 	int is_boundary(int pt, int x, int y);
@@ -162,7 +199,35 @@ public:
 	void set_emap(int x, int y);
 	int parts_avg(int ci, int ni, int t);
 	void UpdateParticles(int start, int end); // Dispatches an update to the range [start, end).
+	void SetUpdateThreads(int newUpdateThreads); // 1 disables parallel updates
+	int GetUpdateThreads() const;
+	// Null if parallel updates are disabled. Other work done between frames may use it too.
+	WorkerPool *GetUpdatePool() const
+	{
+		return updatePool.get();
+	}
+	void SetSleepingRegions(bool newSleepingRegions); // skip static particles in cells that haven't changed for a while
+	bool GetSleepingRegions() const
+	{
+		return sleepingRegions;
+	}
 	void SimulateGoL();
+	void SetHeatGrid(bool newHeatGrid); // conduct heat between particles in a stencil pass over a per-pixel grid
+	bool GetHeatGrid() const
+	{
+		return heatGridEnabled;
+	}
+	// Moves all particles to the front of parts, sorted along a Z-order curve by position.
+	// This changes particle IDs, anything holding on to one across the call is invalidated.
+	void CompactParticles();
+	void SetCompactInterval(int newCompactInterval) // 0 disables, otherwise BeforeSim compacts every this many frames
+	{
+		compactInterval = newCompactInterval;
+	}
+	int GetCompactInterval() const
+	{
+		return compactInterval;
+	}
 	void RecalcFreeParticles(bool do_life_dec);
 	void CheckStacking();
 	void BeforeSim();
@@ -247,4 +312,76 @@ public:
 
 private:
 	CoordStack& getCoordStackSingleton();
+
+	// Parallel pre-pass of UpdateParticles, see UpdateParticlesParallel.
+	std::unique_ptr<WorkerPool> updatePool;
+	std::vector<unsigned char> updatedInParallel; // per particle, set if the serial loop should skip it
+	std::vector<int> tileStart;
+	std::vector<int> tileParts;
+	void UpdateParticlesParallel();
+	bool UpdateStaticParticle(int i, CounterRNG &rng);
+
+	// Types whose particles, while motionless, only conduct heat; see UpdateStaticTypes.
+	std::array<bool, PT_NUM> staticType{};
+	void UpdateStaticTypes();
+	bool IsStaticParticle(const Particle &part, int x, int y) const;
+	bool StaticParticleTriggered(const Particle &part, int x, int y) const;
+	bool CanSleep(const Particle &part, int x, int y) const;
+
+	bool sleepingRegions = false;
+	SleepMap sleepMap;
+	void UpdateSleepMap();
+
+	bool heatGridEnabled = false;
+	bool heatGridPass = false; // set by BeforeSim if ConductHeatGrid ran this frame
+	HeatGrid heatGrid;
+	std::vector<int> heatGridTick; // per particle, the last tick in which ConductHeatGrid covered it
+	std::array<float, PT_NUM> heatGridRate{};
+	std::array<float, PT_NUM> heatGridCapacity{};
+	void ConductHeatGrid();
+	bool HeatGridConducted(int i) const
+	{
+		return heatGridPass && heatGridTick[i] == currentTick;
+	}
+
+	int compactInterval = 0;
+	std::vector<uint64_t> compactOrder; // Morton code << 32 | old ID
+	std::vector<int> compactIDs; // old ID -> new ID, -1 for empty slots
+	std::vector<Particle> compactParts;
+	void CompactParticleSlots();
+
+	// The particles entered into each pixel by PmapAdd, as lists linked through pmapSlots, so
+	// that pixels that changed can be rebuilt without a scan of every particle.
+	struct PmapSlot
+	{
+		int cell = -1; // y * XRES + x, -1 if not entered
+		int next = -1; // the next particle in the same pixel, -1 if none
+		int type = 0; // as entered, so that changes made without PmapAdd can be spotted
+		bool energy = false;
+	};
+	PmapSlot pmapSlots[NPART];
+	int pmapHead[YRES][XRES]; // -1 if no particles are entered into the pixel
+	int pmapRowParts[YRES]; // how many particles are entered into each row
+	bool pmapChanged[YRES][XRES];
+	std::vector<int> pmapChangedCells; // y * XRES + x of the pixels set in pmapChanged
+	std::vector<int> pmapCellParts;
+	void MarkPmapCell(int x, int y)
+	{
+		if (!pmapChanged[y][x])
+		{
+			pmapChanged[y][x] = true;
+			pmapChangedCells.push_back(y * XRES + x);
+		}
+	}
+	void ResetPmap();
+	void RecalcPmapCells();
+	void VerifyPmap();
+	// Scratch space for CheckStacking
+	std::vector<int> excessiveStacking;
+	std::vector<unsigned int> excessiveStackingStrength;
+
+	// LOVE and LOLZ handling in BeforeSim, see UpdateLoveLolz.
+	std::vector<int> loveLolzCells; // y * XRES + x of LOVE and LOLZ on top of pmap
+	std::vector<int> loveLolzBlocks; // x / 9 * (YRES / 9) + y / 9 of 9x9 blocks that have them
+	void UpdateLoveLolz();
 };
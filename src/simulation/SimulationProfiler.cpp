@@ -0,0 +1,81 @@
+#include "SimulationProfiler.h"
+#include <initializer_list>
+
+static constexpr float averageWeight = 0.05f;
+
+void SimulationProfiler::Commit()
+{
+	for (int i = 0; i < phaseCount; i++)
+	{
+		auto &time = times[i];
+		time.last = std::chrono::duration<float, std::milli>(current[i]).count();
+		time.average += (time.last - time.average) * averageWeight;
+		current[i] = Clock::duration::zero();
+	}
+	if (!elementTiming)
+	{
+		return;
+	}
+	for (int t = 0; t < PT_NUM; t++)
+	{
+		auto &cost = elementCosts[t];
+		auto &accumulator = currentElements[t];
+		for (int f = 0; f < functionCount; f++)
+		{
+			cost.time[f] += (std::chrono::duration<float, std::milli>(accumulator.time[f]).count() - cost.time[f]) * averageWeight;
+			cost.calls[f] += (float(accumulator.calls[f]) - cost.calls[f]) * averageWeight;
+		}
+		accumulator = {};
+	}
+}
+
+void SimulationProfiler::Clear()
+{
+	current = {};
+	times = {};
+	currentElements = {};
+	elementCosts = {};
+}
+
+void SimulationProfiler::SetElementTiming(bool newElementTiming)
+{
+	if (newElementTiming && !elementTiming)
+	{
+		currentElements = {};
+		elementCosts = {};
+	}
+	elementTiming = newElementTiming;
+}
+
+SimulationProfiler::PhaseTime SimulationProfiler::GetFrameTime() const
+{
+	PhaseTime frame;
+	for (auto phase : { phaseBeforeSim, phaseUpdateParticles, phaseAfterSim })
+	{
+		frame.last += times[phase].last;
+		frame.average += times[phase].average;
+	}
+	return frame;
+}
+
+const char *SimulationProfiler::PhaseName(Phase phase)
+{
+	switch (phase)
+	{
+	case phaseBeforeSim:       return "beforeSim";
+	case phaseAir:             return "air";
+	case phaseAirHeat:         return "airHeat";
+	case phaseGravity:         return "gravity";
+	case phaseGravityMask:     return "gravityMask";
+	case phaseRecalcFree:      return "recalcFree";
+	case phaseStacking:        return "stacking";
+	case phaseLoveLolz:        return "loveLolz";
+	case phaseWire:            return "wire";
+	case phaseGol:             return "gol";
+	case phaseHeatGrid:        return "heatGrid";
+	case phaseUpdateParticles: return "updateParticles";
+	case phaseAfterSim:        return "afterSim";
+	default:                   break;
+	}
+	return "";
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include "ElementDefs.h"
+#include <array>
+#include <chrono>
+
+class SimulationProfiler
+{
+public:
+	enum Phase
+	{
+		phaseBeforeSim, // everything below up to phaseUpdateParticles is part of this one
+		phaseAir,
+		phaseAirHeat,
+		phaseGravity,
+		phaseGravityMask,
+		phaseRecalcFree,
+		phaseStacking,
+		phaseLoveLolz,
+		phaseWire,
+		phaseGol,
+		phaseHeatGrid,
+		phaseUpdateParticles,
+		phaseAfterSim,
+		phaseCount,
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	class Scope
+	{
+		SimulationProfiler &profiler;
+		Phase phase;
+		Clock::time_point start;
+
+	public:
+		Scope(SimulationProfiler &newProfiler, Phase newPhase) : profiler(newProfiler), phase(newPhase), start(Clock::now())
+		{
+		}
+
+		~Scope()
+		{
+			profiler.current[phase] += Clock::now() - start;
+		}
+	};
+
+	struct PhaseTime
+	{
+		float last = 0; // milliseconds spent in the phase during the last frame
+		float average = 0; // exponential moving average of the above
+	};
+
+	enum ElementFunction
+	{
+		functionUpdate,
+		functionGraphics,
+		functionCount,
+	};
+
+	// Moving averages per frame, like PhaseTime::average.
+	struct ElementCost
+	{
+		std::array<float, functionCount> time{}; // milliseconds
+		std::array<float, functionCount> calls{};
+
+		float TotalTime() const
+		{
+			return time[functionUpdate] + time[functionGraphics];
+		}
+	};
+
+	// Times a single call to an element's Update or Graphics function.
+	class ElementScope
+	{
+		SimulationProfiler &profiler;
+		int type;
+		ElementFunction function;
+		Clock::time_point start;
+
+	public:
+		ElementScope(SimulationProfiler &newProfiler, int newType, ElementFunction newFunction) : profiler(newProfiler), type(newType), function(newFunction), start(Clock::now())
+		{
+		}
+
+		~ElementScope()
+		{
+			auto &current = profiler.currentElements[type];
+			current.time[function] += Clock::now() - start;
+			current.calls[function] += 1;
+		}
+	};
+
+private:
+	std::array<Clock::duration, phaseCount> current{};
+	std::array<PhaseTime, phaseCount> times{};
+
+	struct ElementAccumulator
+	{
+		std::array<Clock::duration, functionCount> time{};
+		std::array<unsigned int, functionCount> calls{};
+	};
+	std::array<ElementAccumulator, PT_NUM> currentElements{};
+	std::array<ElementCost, PT_NUM> elementCosts{};
+
+	// Timing every Update and Graphics call costs two clock reads per particle, so it is opt-in.
+	bool elementTiming = false;
+
+public:
+	// Called at the start of every frame, folds the time measured during the previous one into the averages.
+	void Commit();
+	void Clear();
+
+	const PhaseTime &GetTime(Phase phase) const
+	{
+		return times[phase];
+	}
+
+	// Total of the top-level phases, i.e. the whole frame.
+	PhaseTime GetFrameTime() const;
+
+	bool GetElementTiming() const
+	{
+		return elementTiming;
+	}
+
+	void SetElementTiming(bool newElementTiming);
+
+	const ElementCost &GetElementCost(int type) const
+	{
+		return elementCosts[type];
+	}
+
+	static const char *PhaseName(Phase phase);
+};
@@ -0,0 +1,44 @@
+#include "SleepMap.h"
+
+void SleepMap::Clear()
+{
+	signatures = {};
+	quietFrames = {};
+}
+
+void SleepMap::Begin()
+{
+	nextSignatures.fill(UINT32_C(0x811c9dc5));
+}
+
+void SleepMap::Commit()
+{
+	for (int i = 0; i < NCELL; i++)
+	{
+		changed[i] = nextSignatures[i] != signatures[i];
+	}
+	for (int cy = 0; cy < YCELLS; cy++)
+	{
+		for (int cx = 0; cx < XCELLS; cx++)
+		{
+			bool woken = false;
+			for (int ny = cy - 1; ny <= cy + 1 && !woken; ny++)
+			{
+				for (int nx = cx - 1; nx <= cx + 1; nx++)
+				{
+					if (nx >= 0 && ny >= 0 && nx < XCELLS && ny < YCELLS && changed[ny * XCELLS + nx])
+					{
+						woken = true;
+						break;
+					}
+				}
+			}
+			auto &quiet = quietFrames[cy * XCELLS + cx];
+			if (woken)
+				quiet = 0;
+			else if (quiet < sleepAfter)
+				quiet++;
+		}
+	}
+	signatures = nextSignatures;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "SimulationConfig.h"
+#include <array>
+#include <cstdint>
+
+// Tracks which CELLs have looked the same for a while. Every frame, the particles and
+// walls in a cell are folded into a signature; a cell whose signature and those of its
+// eight neighbours haven't changed for sleepAfter frames is asleep. Any change wakes the
+// cell and its neighbours up again on the next frame.
+class SleepMap
+{
+public:
+	static constexpr int sleepAfter = 10;
+
+private:
+	std::array<uint32_t, NCELL> signatures{};
+	std::array<uint32_t, NCELL> nextSignatures{};
+	std::array<bool, NCELL> changed{};
+	std::array<unsigned char, NCELL> quietFrames{};
+
+public:
+	void Clear();
+
+	bool Asleep(int cx, int cy) const
+	{
+		return quietFrames[cy * XCELLS + cx] >= sleepAfter;
+	}
+
+	void Begin();
+
+	void Add(int cx, int cy, uint32_t value)
+	{
+		auto &signature = nextSignatures[cy * XCELLS + cx];
+		signature = (signature ^ value) * UINT32_C(0x01000193);
+	}
+
+	// Compares the signatures built since Begin with those from the previous frame.
+	void Commit();
+};
@@ -2,32 +2,39 @@
 #include "Particle.h"
 #include "Sign.h"
 #include "Stickman.h"
+#include "TiledVector.h"
 #include <vector>
 #include <json/json.h>
 
 class Snapshot
 {
 public:
-	std::vector<float> AirPressure;
-	std::vector<float> AirVelocityX;
-	std::vector<float> AirVelocityY;
-	std::vector<float> AmbientHeat;
+	// Fields that are big enough to be worth it are tiled, so Snapshots taken of mostly the same
+	// simulation share most of their memory, see TiledVector and Simulation::CreateSnapshot.
+	template<class Item>
+	using MapTiles = TiledVector<Item, 1024>;
+	using ParticleTiles = TiledVector<Particle, 256>;
 
-	std::vector<Particle> Particles;
+	MapTiles<float> AirPressure;
+	MapTiles<float> AirVelocityX;
+	MapTiles<float> AirVelocityY;
+	MapTiles<float> AmbientHeat;
 
-	std::vector<float> GravVelocityX;
-	std::vector<float> GravVelocityY;
-	std::vector<float> GravValue;
-	std::vector<float> GravMap;
+	ParticleTiles Particles;
 
-	std::vector<unsigned char> BlockMap;
-	std::vector<unsigned char> ElecMap;
+	MapTiles<float> GravVelocityX;
+	MapTiles<float> GravVelocityY;
+	MapTiles<float> GravValue;
+	MapTiles<float> GravMap;
 
-	std::vector<float> FanVelocityX;
-	std::vector<float> FanVelocityY;
+	MapTiles<unsigned char> BlockMap;
+	MapTiles<unsigned char> ElecMap;
 
+	MapTiles<float> FanVelocityX;
+	MapTiles<float> FanVelocityY;
 
-	std::vector<Particle> PortalParticles;
+
+	ParticleTiles PortalParticles;
 	std::vector<int> WirelessData;
 	std::vector<playerst> stickmen;
 	std::vector<sign> signs;
@@ -1,6 +1,15 @@
 #include "SnapshotDelta.h"
 #include "common/tpt-minmax.h"
+#include "common/WorkerPool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
 #include <utility>
+#include <zlib.h>
 
 // * A SnapshotDelta is a bidirectional difference type between Snapshots, defined such
 //   that SnapshotDelta d = SnapshotDelta::FromSnapshots(A, B) yields a SnapshotDelta which can be
@@ -66,6 +75,11 @@
 //   structs, even though Snapshot::stickmen is not big enough for us to benefit from this. The
 //   alternative would have been to implement operator ==(const playerst &, const playerst &), which
 //   would have been tedious.
+// * Fields that are TiledVectors in Snapshot are diffed tile by tile with FillHunkVectorTiled. Tiles
+//   that both Snapshots share are known to be identical and are skipped without being looked at, which
+//   is most of them when little has changed between the two, see Simulation::CreateSnapshot. Hunks
+//   thus never span tiles, though ApplyHunkVectorTiled doesn't rely on this. Applying a hunk copies
+//   the tile it lands in first if the tile is shared with another Snapshot.
 
 constexpr size_t ParticleUint32Count = sizeof(Particle) / sizeof(uint32_t);
 static_assert(sizeof(Particle) % sizeof(uint32_t) == 0, "fix me");
@@ -116,40 +130,56 @@ bool operator ==(const std::vector<sign> &lhs, const std::vector<sign> &rhs)
 	return true;
 }
 
+// * FillHunkVectorPtr skips identical stretches of the streams a block of blockBytes at a time, which
+//   compiles to a handful of vector compares per block, and only compares item by item in blocks that
+//   differ. Items are compared bitwise, which unlike operator == also tells 0 from -0. Differences
+//   separated by no more identical items than a Hunk is worth in Diffs are put in the same Hunk.
+constexpr size_t blockBytes = 64;
+
 template<class Item>
-void FillHunkVectorPtr(const Item *oldItems, const Item *newItems, SnapshotDelta::HunkVector<Item> &out, size_t size)
+void FillHunkVectorPtr(const Item *oldItems, const Item *newItems, SnapshotDelta::HunkVector<Item> &out, size_t size, size_t baseOffset = 0)
 {
-	auto i = 0U;
-	bool different = false;
-	auto offset = 0U;
-	auto markDifferent = [oldItems, newItems, &out, &i, &different, &offset](bool mark) {
-		if (mark && !different)
+	constexpr size_t blockItems = std::max(size_t(1), blockBytes / sizeof(Item));
+	constexpr size_t mergeGap = sizeof(SnapshotDelta::Hunk<Item>) / sizeof(SnapshotDelta::Diff<Item>);
+	auto same = [oldItems, newItems](size_t i, size_t count) {
+		return !std::memcmp(&oldItems[i], &newItems[i], count * sizeof(Item));
+	};
+	size_t i = 0;
+	while (i < size)
+	{
+		while (i + blockItems <= size && same(i, blockItems))
+		{
+			i += blockItems;
+		}
+		while (i < size && same(i, 1))
+		{
+			i += 1;
+		}
+		if (i == size)
 		{
-			different = true;
-			offset = i;
+			break;
 		}
-		else if (!mark && different)
+		auto offset = i;
+		auto end = i + 1;
+		for (auto j = end; j < size && j - end <= mergeGap; ++j)
 		{
-			different = false;
-			auto size = i - offset;
-			out.emplace_back();
-			auto &hunk = out.back();
-			hunk.offset = offset;
-			auto &diffs = hunk.diffs;
-			diffs.resize(size);
-			for (auto j = 0U; j < size; ++j)
+			if (!same(j, 1))
 			{
-				diffs[j].oldItem = oldItems[offset + j];
-				diffs[j].newItem = newItems[offset + j];
+				end = j + 1;
 			}
 		}
-	};
-	while (i < size)
-	{
-		markDifferent(!(oldItems[i] == newItems[i]));
-		i += 1U;
+		out.emplace_back();
+		auto &hunk = out.back();
+		hunk.offset = int(baseOffset + offset);
+		auto &diffs = hunk.diffs;
+		diffs.resize(end - offset);
+		for (auto j = 0U; j < diffs.size(); ++j)
+		{
+			diffs[j].oldItem = oldItems[offset + j];
+			diffs[j].newItem = newItems[offset + j];
+		}
+		i = end;
 	}
-	markDifferent(false);
 }
 
 template<class Item>
@@ -158,6 +188,29 @@ void FillHunkVector(const std::vector<Item> &oldItems, const std::vector<Item> &
 	FillHunkVectorPtr<Item>(&oldItems[0], &newItems[0], out, std::min(oldItems.size(), newItems.size()));
 }
 
+// * tileBegin and tileEnd limit the diff to a range of tiles, so it can be split up between threads.
+template<class Word, class Item, size_t TileSize>
+void FillHunkVectorTiled(const TiledVector<Item, TileSize> &oldItems, const TiledVector<Item, TileSize> &newItems, SnapshotDelta::HunkVector<Word> &out, size_t size, size_t tileBegin = 0, size_t tileEnd = SIZE_MAX)
+{
+	constexpr size_t wordsPerItem = sizeof(Item) / sizeof(Word);
+	static_assert(sizeof(Item) % sizeof(Word) == 0, "fix me");
+	for (auto tile = tileBegin; tile < tileEnd && tile * TileSize < size; ++tile)
+	{
+		if (oldItems.SharesTile(newItems, tile))
+		{
+			continue;
+		}
+		auto items = std::min(TileSize, size - tile * TileSize);
+		FillHunkVectorPtr(reinterpret_cast<const Word *>(oldItems.TileData(tile)), reinterpret_cast<const Word *>(newItems.TileData(tile)), out, items * wordsPerItem, tile * TileSize * wordsPerItem);
+	}
+}
+
+template<class Item, size_t TileSize>
+void FillHunkVector(const TiledVector<Item, TileSize> &oldItems, const TiledVector<Item, TileSize> &newItems, SnapshotDelta::HunkVector<Item> &out)
+{
+	FillHunkVectorTiled<Item>(oldItems, newItems, out, std::min(oldItems.size(), newItems.size()));
+}
+
 template<class Item>
 void FillSingleDiff(const Item &oldItem, const Item &newItem, SnapshotDelta::SingleDiff<Item> &out)
 {
@@ -189,6 +242,33 @@ void ApplyHunkVector(const SnapshotDelta::HunkVector<Item> &in, std::vector<Item
 	ApplyHunkVectorPtr<UseOld, Item>(in, &items[0]);
 }
 
+template<bool UseOld, class Word, class Item, size_t TileSize>
+void ApplyHunkVectorTiled(const SnapshotDelta::HunkVector<Word> &in, TiledVector<Item, TileSize> &items)
+{
+	constexpr size_t wordsPerTile = TileSize * sizeof(Item) / sizeof(Word);
+	for (auto &hunk : in)
+	{
+		auto &diffs = hunk.diffs;
+		auto j = 0U;
+		while (j < diffs.size())
+		{
+			size_t offset = hunk.offset + j;
+			auto *words = reinterpret_cast<Word *>(items.WritableTileData(offset / wordsPerTile));
+			auto end = std::min(diffs.size(), j + wordsPerTile - offset % wordsPerTile);
+			for (; j < end; ++j, ++offset)
+			{
+				words[offset % wordsPerTile] = UseOld ? diffs[j].oldItem : diffs[j].newItem;
+			}
+		}
+	}
+}
+
+template<bool UseOld, class Item, size_t TileSize>
+void ApplyHunkVector(const SnapshotDelta::HunkVector<Item> &in, TiledVector<Item, TileSize> &items)
+{
+	ApplyHunkVectorTiled<UseOld>(in, items);
+}
+
 template<bool UseOld, class Item>
 void ApplySingleDiff(const SnapshotDelta::SingleDiff<Item> &in, Item &item)
 {
@@ -198,41 +278,240 @@ void ApplySingleDiff(const SnapshotDelta::SingleDiff<Item> &in, Item &item)
 	}
 }
 
-std::unique_ptr<SnapshotDelta> SnapshotDelta::FromSnapshots(const Snapshot &oldSnap, const Snapshot &newSnap)
+// * Compress serialises every HunkVector and the extraParts fields into one stream and deflates it.
+//   The items in a HunkVector are written as they are in memory, which is fine because the stream
+//   never leaves the process. signs and Authors are left alone, they are tiny in comparison.
+template<class Delta, class Func>
+void ForEachHunkVector(Delta &delta, Func func)
+{
+	func(delta.AirPressure    );
+	func(delta.AirVelocityX   );
+	func(delta.AirVelocityY   );
+	func(delta.AmbientHeat    );
+	func(delta.commonParticles);
+	func(delta.GravVelocityX  );
+	func(delta.GravVelocityY  );
+	func(delta.GravValue      );
+	func(delta.GravMap        );
+	func(delta.BlockMap       );
+	func(delta.ElecMap        );
+	func(delta.FanVelocityX   );
+	func(delta.FanVelocityY   );
+	func(delta.PortalParticles);
+	func(delta.WirelessData   );
+	func(delta.stickmen       );
+}
+
+template<class Item>
+void PutItems(std::vector<unsigned char> &out, const Item *items, size_t count)
+{
+	static_assert(std::is_trivially_copyable_v<Item>, "fix me");
+	auto *begin = reinterpret_cast<const unsigned char *>(items);
+	out.insert(out.end(), begin, begin + count * sizeof(Item));
+}
+
+template<class Item>
+void GetItems(const unsigned char *&in, Item *items, size_t count)
+{
+	if (count)
+	{
+		std::memcpy(reinterpret_cast<void *>(items), in, count * sizeof(Item));
+		in += count * sizeof(Item);
+	}
+}
+
+template<class Item>
+void PutVector(std::vector<unsigned char> &out, const std::vector<Item> &items)
+{
+	uint32_t count = items.size();
+	PutItems(out, &count, 1);
+	PutItems(out, items.data(), count);
+}
+
+template<class Item>
+void GetVector(const unsigned char *&in, std::vector<Item> &items)
+{
+	uint32_t count;
+	GetItems(in, &count, 1);
+	items.resize(count);
+	GetItems(in, items.data(), count);
+}
+
+template<class Item>
+void PutHunkVector(std::vector<unsigned char> &out, const SnapshotDelta::HunkVector<Item> &hunks)
+{
+	uint32_t count = hunks.size();
+	PutItems(out, &count, 1);
+	for (auto &hunk : hunks)
+	{
+		PutItems(out, &hunk.offset, 1);
+		PutVector(out, hunk.diffs);
+	}
+}
+
+template<class Item>
+void GetHunkVector(const unsigned char *&in, SnapshotDelta::HunkVector<Item> &hunks)
+{
+	uint32_t count;
+	GetItems(in, &count, 1);
+	hunks.resize(count);
+	for (auto &hunk : hunks)
+	{
+		GetItems(in, &hunk.offset, 1);
+		GetVector(in, hunk.diffs);
+	}
+}
+
+template<class Item>
+size_t HunkVectorBytes(const SnapshotDelta::HunkVector<Item> &hunks)
+{
+	auto bytes = hunks.capacity() * sizeof(SnapshotDelta::Hunk<Item>);
+	for (auto &hunk : hunks)
+	{
+		bytes += hunk.diffs.capacity() * sizeof(SnapshotDelta::Diff<Item>);
+	}
+	return bytes;
+}
+
+static size_t UncompressedBytes(const SnapshotDelta &delta)
+{
+	auto bytes = sizeof(SnapshotDelta);
+	ForEachHunkVector(delta, [&bytes](auto &hunks) {
+		bytes += HunkVectorBytes(hunks);
+	});
+	bytes += (delta.extraPartsOld.capacity() + delta.extraPartsNew.capacity()) * sizeof(Particle);
+	return bytes;
+}
+
+void SnapshotDelta::Compress()
+{
+	if (Compressed())
+	{
+		return;
+	}
+	std::vector<unsigned char> raw;
+	ForEachHunkVector(*this, [&raw](auto &hunks) {
+		PutHunkVector(raw, hunks);
+	});
+	PutVector(raw, extraPartsOld);
+	PutVector(raw, extraPartsNew);
+	auto size = compressBound(raw.size());
+	std::vector<unsigned char> out(size);
+	if (compress2(out.data(), &size, raw.data(), raw.size(), Z_BEST_SPEED) != Z_OK)
+	{
+		// Not worth failing over, this SnapshotDelta just stays uncompressed
+		return;
+	}
+	out.resize(size);
+	out.shrink_to_fit();
+	compressed = std::move(out);
+	uncompressedSize = raw.size();
+	ForEachHunkVector(*this, [](auto &hunks) {
+		std::remove_reference_t<decltype(hunks)>().swap(hunks);
+	});
+	std::vector<Particle>().swap(extraPartsOld);
+	std::vector<Particle>().swap(extraPartsNew);
+	bytes = sizeof(SnapshotDelta) + compressed.size();
+}
+
+std::unique_ptr<SnapshotDelta> SnapshotDelta::Decompressed() const
 {
 	auto ptr = std::make_unique<SnapshotDelta>();
 	auto &delta = *ptr;
-	FillHunkVector(oldSnap.AirPressure    , newSnap.AirPressure    , delta.AirPressure    );
-	FillHunkVector(oldSnap.AirVelocityX   , newSnap.AirVelocityX   , delta.AirVelocityX   );
-	FillHunkVector(oldSnap.AirVelocityY   , newSnap.AirVelocityY   , delta.AirVelocityY   );
-	FillHunkVector(oldSnap.AmbientHeat    , newSnap.AmbientHeat    , delta.AmbientHeat    );
-	FillHunkVector(oldSnap.GravVelocityX  , newSnap.GravVelocityX  , delta.GravVelocityX  );
-	FillHunkVector(oldSnap.GravVelocityY  , newSnap.GravVelocityY  , delta.GravVelocityY  );
-	FillHunkVector(oldSnap.GravValue      , newSnap.GravValue      , delta.GravValue      );
-	FillHunkVector(oldSnap.GravMap        , newSnap.GravMap        , delta.GravMap        );
-	FillHunkVector(oldSnap.BlockMap       , newSnap.BlockMap       , delta.BlockMap       );
-	FillHunkVector(oldSnap.ElecMap        , newSnap.ElecMap        , delta.ElecMap        );
-	FillHunkVector(oldSnap.FanVelocityX   , newSnap.FanVelocityX   , delta.FanVelocityX   );
-	FillHunkVector(oldSnap.FanVelocityY   , newSnap.FanVelocityY   , delta.FanVelocityY   );
-	FillHunkVector(oldSnap.WirelessData   , newSnap.WirelessData   , delta.WirelessData   );
-	FillSingleDiff(oldSnap.signs          , newSnap.signs          , delta.signs          );
-	FillSingleDiff(oldSnap.Authors        , newSnap.Authors        , delta.Authors        );
-	FillHunkVectorPtr(reinterpret_cast<const uint32_t *>(&oldSnap.PortalParticles[0]), reinterpret_cast<const uint32_t *>(&newSnap.PortalParticles[0]), delta.PortalParticles, newSnap.PortalParticles.size() * ParticleUint32Count);
-	FillHunkVectorPtr(reinterpret_cast<const uint32_t *>(&oldSnap.stickmen[0])       , reinterpret_cast<const uint32_t *>(&newSnap.stickmen[0]       ), delta.stickmen       , newSnap.stickmen       .size() * playerstUint32Count);
+	delta.signs = signs;
+	delta.Authors = Authors;
+	std::vector<unsigned char> raw(uncompressedSize);
+	uLongf size = raw.size();
+	if (uncompress(raw.data(), &size, compressed.data(), compressed.size()) != Z_OK || size != raw.size())
+	{
+		throw std::runtime_error("failed to decompress SnapshotDelta");
+	}
+	const unsigned char *in = raw.data();
+	ForEachHunkVector(delta, [&in](auto &hunks) {
+		GetHunkVector(in, hunks);
+	});
+	GetVector(in, delta.extraPartsOld);
+	GetVector(in, delta.extraPartsNew);
+	delta.bytes = UncompressedBytes(delta);
+	return ptr;
+}
 
+std::unique_ptr<SnapshotDelta> SnapshotDelta::FromSnapshots(const Snapshot &oldSnap, const Snapshot &newSnap, WorkerPool *pool)
+{
+	auto ptr = std::make_unique<SnapshotDelta>();
+	auto &delta = *ptr;
 	// * Slightly more interesting; this will only diff the common parts, the rest is copied separately.
+	//   The common part is diffed in chunks so it can be split up like the other fields, and the
+	//   chunks are joined in order afterwards.
 	auto commonSize = std::min(oldSnap.Particles.size(), newSnap.Particles.size());
-	FillHunkVectorPtr(reinterpret_cast<const uint32_t *>(&oldSnap.Particles[0]), reinterpret_cast<const uint32_t *>(&newSnap.Particles[0]), delta.commonParticles, commonSize * ParticleUint32Count);
+	constexpr size_t particleChunkTiles = 64;
+	auto particleTiles = (commonSize + Snapshot::ParticleTiles::tileSize - 1) / Snapshot::ParticleTiles::tileSize;
+	std::vector<HunkVector<uint32_t>> particleChunks((particleTiles + particleChunkTiles - 1) / particleChunkTiles);
+
+	std::vector<std::function<void ()>> jobs = {
+		[&]() { FillHunkVector(oldSnap.AirPressure    , newSnap.AirPressure    , delta.AirPressure    ); },
+		[&]() { FillHunkVector(oldSnap.AirVelocityX   , newSnap.AirVelocityX   , delta.AirVelocityX   ); },
+		[&]() { FillHunkVector(oldSnap.AirVelocityY   , newSnap.AirVelocityY   , delta.AirVelocityY   ); },
+		[&]() { FillHunkVector(oldSnap.AmbientHeat    , newSnap.AmbientHeat    , delta.AmbientHeat    ); },
+		[&]() { FillHunkVector(oldSnap.GravVelocityX  , newSnap.GravVelocityX  , delta.GravVelocityX  ); },
+		[&]() { FillHunkVector(oldSnap.GravVelocityY  , newSnap.GravVelocityY  , delta.GravVelocityY  ); },
+		[&]() { FillHunkVector(oldSnap.GravValue      , newSnap.GravValue      , delta.GravValue      ); },
+		[&]() { FillHunkVector(oldSnap.GravMap        , newSnap.GravMap        , delta.GravMap        ); },
+		[&]() { FillHunkVector(oldSnap.BlockMap       , newSnap.BlockMap       , delta.BlockMap       ); },
+		[&]() { FillHunkVector(oldSnap.ElecMap        , newSnap.ElecMap        , delta.ElecMap        ); },
+		[&]() { FillHunkVector(oldSnap.FanVelocityX   , newSnap.FanVelocityX   , delta.FanVelocityX   ); },
+		[&]() { FillHunkVector(oldSnap.FanVelocityY   , newSnap.FanVelocityY   , delta.FanVelocityY   ); },
+		[&]() { FillHunkVector(oldSnap.WirelessData   , newSnap.WirelessData   , delta.WirelessData   ); },
+		[&]() { FillHunkVectorTiled<uint32_t>(oldSnap.PortalParticles, newSnap.PortalParticles, delta.PortalParticles, newSnap.PortalParticles.size()); },
+		[&]() { FillHunkVectorPtr(reinterpret_cast<const uint32_t *>(&oldSnap.stickmen[0]), reinterpret_cast<const uint32_t *>(&newSnap.stickmen[0]), delta.stickmen, newSnap.stickmen.size() * playerstUint32Count); },
+	};
+	for (auto chunk = 0U; chunk < particleChunks.size(); ++chunk)
+	{
+		jobs.push_back([&, chunk]() {
+			FillHunkVectorTiled<uint32_t>(oldSnap.Particles, newSnap.Particles, particleChunks[chunk], commonSize, chunk * particleChunkTiles, (chunk + 1) * particleChunkTiles);
+		});
+	}
+	if (pool)
+	{
+		pool->ParallelFor(int(jobs.size()), [&jobs](int i) {
+			jobs[i]();
+		});
+	}
+	else
+	{
+		for (auto &job : jobs)
+		{
+			job();
+		}
+	}
+	FillSingleDiff(oldSnap.signs          , newSnap.signs          , delta.signs          );
+	FillSingleDiff(oldSnap.Authors        , newSnap.Authors        , delta.Authors        );
+
+	for (auto &chunk : particleChunks)
+	{
+		std::move(chunk.begin(), chunk.end(), std::back_inserter(delta.commonParticles));
+	}
 	delta.extraPartsOld.resize(oldSnap.Particles.size() - commonSize);
-	std::copy(oldSnap.Particles.begin() + commonSize, oldSnap.Particles.end(), delta.extraPartsOld.begin());
+	for (auto i = 0U; i < delta.extraPartsOld.size(); ++i)
+	{
+		delta.extraPartsOld[i] = oldSnap.Particles[commonSize + i];
+	}
 	delta.extraPartsNew.resize(newSnap.Particles.size() - commonSize);
-	std::copy(newSnap.Particles.begin() + commonSize, newSnap.Particles.end(), delta.extraPartsNew.begin());
+	for (auto i = 0U; i < delta.extraPartsNew.size(); ++i)
+	{
+		delta.extraPartsNew[i] = newSnap.Particles[commonSize + i];
+	}
+	delta.bytes = UncompressedBytes(delta);
 
 	return ptr;
 }
 
 std::unique_ptr<Snapshot> SnapshotDelta::Forward(const Snapshot &oldSnap)
 {
+	if (Compressed())
+	{
+		return Decompressed()->Forward(oldSnap);
+	}
 	auto ptr = std::make_unique<Snapshot>(oldSnap);
 	auto &newSnap = *ptr;
 	ApplyHunkVector<false>(AirPressure    , newSnap.AirPressure    );
@@ -250,20 +529,24 @@ std::unique_ptr<Snapshot> SnapshotDelta::Forward(const Snapshot &oldSnap)
 	ApplyHunkVector<false>(WirelessData   , newSnap.WirelessData   );
 	ApplySingleDiff<false>(signs          , newSnap.signs          );
 	ApplySingleDiff<false>(Authors        , newSnap.Authors        );
-	ApplyHunkVectorPtr<false>(PortalParticles, reinterpret_cast<uint32_t *>(&newSnap.PortalParticles[0]));
+	ApplyHunkVectorTiled<false>(PortalParticles, newSnap.PortalParticles);
 	ApplyHunkVectorPtr<false>(stickmen       , reinterpret_cast<uint32_t *>(&newSnap.stickmen[0]       ));
 
 	// * Slightly more interesting; apply the common hunk vector, copy the extra portion separaterly.
-	ApplyHunkVectorPtr<false>(commonParticles, reinterpret_cast<uint32_t *>(&newSnap.Particles[0]));
+	ApplyHunkVectorTiled<false>(commonParticles, newSnap.Particles);
 	auto commonSize = oldSnap.Particles.size() - extraPartsOld.size();
-	newSnap.Particles.resize(commonSize + extraPartsNew.size());
-	std::copy(extraPartsNew.begin(), extraPartsNew.end(), newSnap.Particles.begin() + commonSize);
+	newSnap.Particles.Resize(commonSize + extraPartsNew.size());
+	newSnap.Particles.Write(commonSize, extraPartsNew.data(), extraPartsNew.size());
 
 	return ptr;
 }
 
 std::unique_ptr<Snapshot> SnapshotDelta::Restore(const Snapshot &newSnap)
 {
+	if (Compressed())
+	{
+		return Decompressed()->Restore(newSnap);
+	}
 	auto ptr = std::make_unique<Snapshot>(newSnap);
 	auto &oldSnap = *ptr;
 	ApplyHunkVector<true>(AirPressure    , oldSnap.AirPressure    );
@@ -281,14 +564,14 @@ std::unique_ptr<Snapshot> SnapshotDelta::Restore(const Snapshot &newSnap)
 	ApplyHunkVector<true>(WirelessData   , oldSnap.WirelessData   );
 	ApplySingleDiff<true>(signs          , oldSnap.signs          );
 	ApplySingleDiff<true>(Authors        , oldSnap.Authors        );
-	ApplyHunkVectorPtr<true>(PortalParticles, reinterpret_cast<uint32_t *>(&oldSnap.PortalParticles[0]));
+	ApplyHunkVectorTiled<true>(PortalParticles, oldSnap.PortalParticles);
 	ApplyHunkVectorPtr<true>(stickmen       , reinterpret_cast<uint32_t *>(&oldSnap.stickmen[0]       ));
 
 	// * Slightly more interesting; apply the common hunk vector, copy the extra portion separaterly.
-	ApplyHunkVectorPtr<true>(commonParticles, reinterpret_cast<uint32_t *>(&oldSnap.Particles[0]));
+	ApplyHunkVectorTiled<true>(commonParticles, oldSnap.Particles);
 	auto commonSize = newSnap.Particles.size() - extraPartsNew.size();
-	oldSnap.Particles.resize(commonSize + extraPartsOld.size());
-	std::copy(extraPartsOld.begin(), extraPartsOld.end(), oldSnap.Particles.begin() + commonSize);
+	oldSnap.Particles.Resize(commonSize + extraPartsOld.size());
+	oldSnap.Particles.Write(commonSize, extraPartsOld.data(), extraPartsOld.size());
 
 	return ptr;
 }
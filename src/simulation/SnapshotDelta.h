@@ -2,9 +2,12 @@
 
 #include "Snapshot.h"
 
+#include <atomic>
 #include <memory>
 #include <cstdint>
 
+class WorkerPool;
+
 struct SnapshotDelta
 {
 	template<class Item>
@@ -70,7 +73,31 @@ struct SnapshotDelta
 
 	SingleDiff<Json::Value> Authors;
 
-	static std::unique_ptr<SnapshotDelta> FromSnapshots(const Snapshot &oldSnap, const Snapshot &newSnap);
+	// Set by Compress. The HunkVectors and extraParts fields are empty while this isn't.
+	std::vector<unsigned char> compressed;
+	size_t uncompressedSize = 0;
+	// Approximate memory usage, updated by FromSnapshots and Compress. Safe to read while
+	// another thread is compressing this SnapshotDelta, see DeltaCompressor.
+	std::atomic<size_t> bytes = 0;
+
+	// If pool is set, fields are diffed in parallel between its threads.
+	static std::unique_ptr<SnapshotDelta> FromSnapshots(const Snapshot &oldSnap, const Snapshot &newSnap, WorkerPool *pool = nullptr);
+	// Both decompress a copy of this SnapshotDelta first if it's compressed.
 	std::unique_ptr<Snapshot> Forward(const Snapshot &oldSnap);
 	std::unique_ptr<Snapshot> Restore(const Snapshot &newSnap);
+
+	bool Compressed() const
+	{
+		return !compressed.empty();
+	}
+
+	size_t Bytes() const
+	{
+		return bytes;
+	}
+
+	// Packs the hunks and extra particles into a zlib stream, which takes a fraction of the
+	// memory. Does nothing if already compressed.
+	void Compress();
+	std::unique_ptr<SnapshotDelta> Decompressed() const;
 };
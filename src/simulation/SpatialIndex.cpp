@@ -0,0 +1,67 @@
+#include "SpatialIndex.h"
+
+SpatialIndex::SpatialIndex(TypeIndex &newTypeIndex, const Particle *newParts) : typeIndex(newTypeIndex), parts(newParts)
+{
+}
+
+void SpatialIndex::Clear()
+{
+	Invalidate();
+}
+
+void SpatialIndex::Invalidate()
+{
+	for (int t = 0; t < PT_NUM; t++)
+	{
+		if (grids[t])
+		{
+			grids[t]->valid = false;
+			typeIndex.Added(t).clear();
+		}
+	}
+}
+
+void SpatialIndex::Insert(Grid &grid, TypeIndex::Entry entry)
+{
+	auto &part = parts[entry.i];
+	int bx = BucketX(int(part.x + 0.5f));
+	int by = BucketY(int(part.y + 0.5f));
+	grid.buckets[by * bucketsX + bx].push_back(entry);
+}
+
+SpatialIndex::Grid &SpatialIndex::Sync(int t)
+{
+	auto &grid = grids[t];
+	if (!grid)
+	{
+		grid = std::make_unique<Grid>();
+		typeIndex.Watch(t);
+	}
+	auto &added = typeIndex.Added(t);
+	if (!grid->valid)
+	{
+		for (auto &bucket : grid->buckets)
+		{
+			bucket.clear();
+		}
+		for (auto i : typeIndex.Get(t))
+		{
+			Insert(*grid, { i, typeIndex.Serial(i) });
+		}
+		grid->valid = true;
+	}
+	else
+	{
+		for (auto entry : added)
+		{
+			// Particles that have left the list since, or have been put in it again, are skipped;
+			// the latter have a later entry.
+			if (typeIndex.TypeOf(entry.i) == t && typeIndex.Serial(entry.i) == entry.serial)
+			{
+				Insert(*grid, entry);
+			}
+		}
+	}
+	added.clear();
+	return *grid;
+}
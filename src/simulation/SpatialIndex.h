@@ -0,0 +1,131 @@
+#pragma once
+#include "SimulationConfig.h"
+#include "ElementDefs.h"
+#include "Particle.h"
+#include "TypeIndex.h"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+// Particles of a type, sorted into buckets of bucketSize by bucketSize pixels, for searches
+// that would otherwise have to go through every particle of the type or every pixel of a large
+// area. A type is only indexed once it is first searched for. Its buckets are rebuilt from
+// TypeIndex on the first search after Invalidate, which RecalcFreeParticles calls every frame,
+// and particles that get the type in the meantime are added on the next search. Particles are
+// bucketed by where they were at that point, so one that has since been moved some other way
+// is still found in its old bucket until the next frame; callers get IDs of particles that are
+// still of the type and should use their current position.
+class SpatialIndex
+{
+public:
+	static constexpr int bucketSize = 16;
+	static constexpr int bucketsX = (XRES + bucketSize - 1) / bucketSize;
+	static constexpr int bucketsY = (YRES + bucketSize - 1) / bucketSize;
+
+private:
+	struct Grid
+	{
+		bool valid = false;
+		std::array<std::vector<TypeIndex::Entry>, bucketsX * bucketsY> buckets;
+	};
+
+	TypeIndex &typeIndex;
+	const Particle *parts;
+	std::array<std::unique_ptr<Grid>, PT_NUM> grids;
+
+	static int BucketX(int x)
+	{
+		return std::clamp(x, 0, XRES - 1) / bucketSize;
+	}
+
+	static int BucketY(int y)
+	{
+		return std::clamp(y, 0, YRES - 1) / bucketSize;
+	}
+
+	void Insert(Grid &grid, TypeIndex::Entry entry);
+	Grid &Sync(int t);
+
+	template<class Func>
+	void ForEachInBucket(int t, const Grid &grid, int bx, int by, Func func) const
+	{
+		for (auto &entry : grid.buckets[by * bucketsX + bx])
+		{
+			if (typeIndex.TypeOf(entry.i) == t && typeIndex.Serial(entry.i) == entry.serial)
+			{
+				func(entry.i);
+			}
+		}
+	}
+
+public:
+	SpatialIndex(TypeIndex &newTypeIndex, const Particle *newParts);
+
+	void Clear();
+
+	// Particles may have moved, rebuild the buckets of every indexed type on their next search.
+	void Invalidate();
+
+	// Calls func(i) for every particle of type t in the buckets that overlap the rectangle
+	// from (x0, y0) to (x1, y1), both inclusive, and possibly for some outside it.
+	template<class Func>
+	void ForEachInRect(int t, int x0, int y0, int x1, int y1, Func func)
+	{
+		auto &grid = Sync(t);
+		for (int by = BucketY(y0); by <= BucketY(y1); by++)
+		{
+			for (int bx = BucketX(x0); bx <= BucketX(x1); bx++)
+			{
+				ForEachInBucket(t, grid, bx, by, func);
+			}
+		}
+	}
+
+	// Returns the particle of type t for which distance(i) is smallest, the one with the lowest
+	// ID if there's a tie, or -1 if there's no such particle. distance(i) returns -1 to skip a
+	// particle. Buckets are searched outwards from the one (x, y) is in, so distance(i) must be
+	// at least the Chebyshev distance between (x, y) and the particle, give or take a pixel.
+	template<class Func>
+	int Nearest(int t, int x, int y, Func distance)
+	{
+		auto &grid = Sync(t);
+		int cx = BucketX(x);
+		int cy = BucketY(y);
+		int maxRing = std::max({ cx, bucketsX - 1 - cx, cy, bucketsY - 1 - cy });
+		int foundI = -1;
+		int foundDistance = 0;
+		auto check = [&distance, &foundI, &foundDistance](int i) {
+			auto d = distance(i);
+			if (d >= 0 && (foundI < 0 || d < foundDistance || (d == foundDistance && i < foundI)))
+			{
+				foundI = i;
+				foundDistance = d;
+			}
+		};
+		for (int ring = 0; ring <= maxRing; ring++)
+		{
+			// Anything in this ring or further out is at least this far away.
+			if (foundI >= 0 && (ring - 1) * bucketSize > foundDistance)
+			{
+				break;
+			}
+			for (int by = cy - ring; by <= cy + ring; by++)
+			{
+				if (by < 0 || by >= bucketsY)
+				{
+					continue;
+				}
+				bool edgeRow = by == cy - ring || by == cy + ring;
+				for (int bx = cx - ring; bx <= cx + ring; bx += (edgeRow || ring == 0) ? 1 : 2 * ring)
+				{
+					if (bx >= 0 && bx < bucketsX)
+					{
+						ForEachInBucket(t, grid, bx, by, check);
+					}
+				}
+			}
+		}
+		return foundI;
+	}
+};
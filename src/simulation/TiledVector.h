@@ -0,0 +1,134 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// A vector of Items stored in tiles of TileSize items. Copies share tiles until a tile is
+// written to, at which point the writer gets its own copy of that tile only. Assign also
+// shares the tiles of another TiledVector whose contents are the same as what is being
+// assigned, which is how Snapshots of a mostly unchanged simulation end up sharing most of
+// their memory. Items are compared with memcmp, so they should be trivially copyable and
+// have no padding.
+template<class Item, size_t TileSize>
+class TiledVector
+{
+public:
+	static constexpr size_t tileSize = TileSize;
+
+private:
+	using Tile = std::vector<Item>;
+	size_t count = 0;
+	std::vector<std::shared_ptr<Tile>> tiles;
+
+public:
+	size_t size() const
+	{
+		return count;
+	}
+
+	size_t TileCount() const
+	{
+		return tiles.size();
+	}
+
+	// The last tile may hold fewer than tileSize items.
+	size_t TileItems(size_t tile) const
+	{
+		return tiles[tile]->size();
+	}
+
+	const Item *TileData(size_t tile) const
+	{
+		return tiles[tile]->data();
+	}
+
+	// True if both hold the same tile, which means its contents are also the same.
+	bool SharesTile(const TiledVector &other, size_t tile) const
+	{
+		return tile < tiles.size() && tile < other.tiles.size() && tiles[tile] == other.tiles[tile];
+	}
+
+	Item *WritableTileData(size_t tile)
+	{
+		auto &ptr = tiles[tile];
+		if (ptr.use_count() > 1)
+		{
+			ptr = std::make_shared<Tile>(*ptr);
+		}
+		return ptr->data();
+	}
+
+	const Item &operator [](size_t index) const
+	{
+		return (*tiles[index / tileSize])[index % tileSize];
+	}
+
+	// Tiles whose new contents are the same as those of the same tile in previous, if any,
+	// are shared with it instead of being allocated.
+	void Assign(const Item *items, size_t newCount, const TiledVector *previous = nullptr)
+	{
+		count = newCount;
+		tiles.assign((count + tileSize - 1) / tileSize, nullptr);
+		for (size_t tile = 0; tile < tiles.size(); tile++)
+		{
+			auto *begin = items + tile * tileSize;
+			auto tileItems = std::min(tileSize, count - tile * tileSize);
+			if (previous && tile < previous->tiles.size())
+			{
+				auto &candidate = previous->tiles[tile];
+				if (candidate->size() == tileItems && !std::memcmp(candidate->data(), begin, tileItems * sizeof(Item)))
+				{
+					tiles[tile] = candidate;
+					continue;
+				}
+			}
+			tiles[tile] = std::make_shared<Tile>(begin, begin + tileItems);
+		}
+	}
+
+	void CopyTo(Item *out) const
+	{
+		for (auto &tile : tiles)
+		{
+			out = std::copy(tile->begin(), tile->end(), out);
+		}
+	}
+
+	// New items are value-initialised.
+	void Resize(size_t newCount)
+	{
+		auto newTiles = (newCount + tileSize - 1) / tileSize;
+		tiles.resize(newTiles);
+		for (size_t tile = 0; tile < newTiles; tile++)
+		{
+			auto items = std::min(tileSize, newCount - tile * tileSize);
+			if (!tiles[tile])
+			{
+				tiles[tile] = std::make_shared<Tile>(items);
+			}
+			else if (tiles[tile]->size() != items)
+			{
+				WritableTileData(tile);
+				tiles[tile]->resize(items);
+			}
+		}
+		count = newCount;
+	}
+
+	// Writes items to index and onwards, which must already be in range.
+	void Write(size_t index, const Item *items, size_t itemCount)
+	{
+		while (itemCount)
+		{
+			auto tile = index / tileSize;
+			auto offset = index % tileSize;
+			auto run = std::min(itemCount, tiles[tile]->size() - offset);
+			std::copy(items, items + run, WritableTileData(tile) + offset);
+			index += run;
+			items += run;
+			itemCount -= run;
+		}
+	}
+};
@@ -0,0 +1,213 @@
+#include "TimeTravel.h"
+#include "Simulation.h"
+#include "Snapshot.h"
+#include "SnapshotDelta.h"
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+TimeTravel::TimeTravel(size_t newBudget) : budget(newBudget)
+{
+}
+
+TimeTravel::~TimeTravel()
+{
+	// * Needed because Snapshot and SnapshotDelta are incomplete types in TimeTravel.h.
+	//   compressor is declared last, so its thread is stopped before frames are freed.
+}
+
+// A Snapshot of the same shape as like with nothing in it, which keyframes are diffed against.
+static std::unique_ptr<Snapshot> BlankLike(const Snapshot &like)
+{
+	auto blank = std::make_unique<Snapshot>();
+	auto zero = [](auto &field, const auto &likeField, size_t count) {
+		std::vector<std::decay_t<decltype(likeField[0])>> items(count);
+		field.Assign(items.data(), items.size());
+	};
+	zero(blank->AirPressure    , like.AirPressure    , like.AirPressure    .size());
+	zero(blank->AirVelocityX   , like.AirVelocityX   , like.AirVelocityX   .size());
+	zero(blank->AirVelocityY   , like.AirVelocityY   , like.AirVelocityY   .size());
+	zero(blank->AmbientHeat    , like.AmbientHeat    , like.AmbientHeat    .size());
+	zero(blank->GravVelocityX  , like.GravVelocityX  , like.GravVelocityX  .size());
+	zero(blank->GravVelocityY  , like.GravVelocityY  , like.GravVelocityY  .size());
+	zero(blank->GravValue      , like.GravValue      , like.GravValue      .size());
+	zero(blank->GravMap        , like.GravMap        , like.GravMap        .size());
+	zero(blank->BlockMap       , like.BlockMap       , like.BlockMap       .size());
+	zero(blank->ElecMap        , like.ElecMap        , like.ElecMap        .size());
+	zero(blank->FanVelocityX   , like.FanVelocityX   , like.FanVelocityX   .size());
+	zero(blank->FanVelocityY   , like.FanVelocityY   , like.FanVelocityY   .size());
+	zero(blank->PortalParticles, like.PortalParticles, like.PortalParticles.size());
+	blank->WirelessData.resize(like.WirelessData.size());
+	blank->stickmen.resize(like.stickmen.size());
+	return blank;
+}
+
+static size_t SnapshotBytes(const Snapshot &snap)
+{
+	size_t bytes = 0;
+	auto add = [&bytes](const auto &field) {
+		bytes += field.size() * sizeof(field[0]);
+	};
+	add(snap.AirPressure    );
+	add(snap.AirVelocityX   );
+	add(snap.AirVelocityY   );
+	add(snap.AmbientHeat    );
+	add(snap.Particles      );
+	add(snap.GravVelocityX  );
+	add(snap.GravVelocityY  );
+	add(snap.GravValue      );
+	add(snap.GravMap        );
+	add(snap.BlockMap       );
+	add(snap.ElecMap        );
+	add(snap.FanVelocityX   );
+	add(snap.FanVelocityY   );
+	add(snap.PortalParticles);
+	add(snap.WirelessData   );
+	add(snap.stickmen       );
+	add(snap.signs          );
+	return bytes;
+}
+
+void TimeTravel::DropFront(size_t count)
+{
+	for (auto i = 0U; i < count; ++i)
+	{
+		compressor.Settle(frames.front().delta.get());
+		frames.pop_front();
+	}
+	cursor -= count;
+}
+
+void TimeTravel::DropBack(size_t count)
+{
+	for (auto i = 0U; i < count; ++i)
+	{
+		compressor.Settle(frames.back().delta.get());
+		frames.pop_back();
+	}
+}
+
+void TimeTravel::Record(Simulation &sim)
+{
+	auto snap = sim.CreateSnapshot();
+	if (!blank)
+	{
+		blank = BlankLike(*snap);
+	}
+	if (!frames.empty())
+	{
+		DropBack(frames.size() - 1U - cursor);
+	}
+	auto keyframe = frames.empty() || sinceKeyframe >= keyframeInterval;
+	frames.push_back({ keyframe, SnapshotDelta::FromSnapshots(keyframe ? *blank : *last, *snap, sim.GetUpdatePool()) });
+	compressor.Push(frames.back().delta.get());
+	cursor = frames.size() - 1U;
+	last = std::move(snap);
+	sinceKeyframe = keyframe ? 1 : sinceKeyframe + 1;
+
+	EnforceBudget(sim);
+}
+
+size_t TimeTravel::Bytes() const
+{
+	// blank and last are whole Snapshots, though last shares most of its tiles with the
+	// simulation's own copy, see Simulation::CreateSnapshot
+	size_t bytes = SnapshotBytes(*blank) + SnapshotBytes(*last);
+	for (auto &frame : frames)
+	{
+		bytes += frame.delta->Bytes();
+	}
+	return bytes;
+}
+
+void TimeTravel::EnforceBudget(Simulation &sim)
+{
+	auto bytes = Bytes();
+	if (bytes <= budget || frames.size() <= 1U)
+	{
+		return;
+	}
+	// Deltas that are still being compressed count as their uncompressed size, give them a chance to shrink first
+	compressor.Wait();
+	bytes = Bytes();
+	while (bytes > budget)
+	{
+		size_t next = 1;
+		while (next < frames.size() && !frames[next].keyframe)
+		{
+			next += 1;
+		}
+		if (next == frames.size())
+		{
+			break;
+		}
+		for (auto i = 0U; i < next; ++i)
+		{
+			bytes -= frames[i].delta->Bytes();
+		}
+		DropFront(next);
+	}
+	if (bytes > budget && frames.size() > 1U)
+	{
+		// Even the ticks since the only keyframe left are too much, turn the newest one into a
+		// keyframe so that everything before it can go. It's the only one left then, which is
+		// kept even if it doesn't fit by itself.
+		auto &newest = frames.back();
+		compressor.Settle(newest.delta.get());
+		newest.keyframe = true;
+		newest.delta = SnapshotDelta::FromSnapshots(*blank, *last, sim.GetUpdatePool());
+		compressor.Push(newest.delta.get());
+		sinceKeyframe = 1;
+		DropFront(frames.size() - 1U);
+	}
+}
+
+void TimeTravel::SeekTo(Simulation &sim, size_t target)
+{
+	auto from = target;
+	while (!frames[from].keyframe)
+	{
+		from -= 1U;
+	}
+	std::unique_ptr<Snapshot> snap;
+	for (auto i = from; i <= target; ++i)
+	{
+		auto &delta = *frames[i].delta;
+		compressor.Settle(&delta);
+		snap = delta.Forward(snap ? *snap : *blank);
+	}
+	sim.Restore(*snap);
+	last = std::move(snap);
+	cursor = target;
+	// Recording from here on continues the same keyframe interval, and those past the cursor
+	// are dropped by then.
+	sinceKeyframe = int(target - from) + 1;
+}
+
+int TimeTravel::Back(Simulation &sim, int ticks)
+{
+	if (frames.empty() || ticks <= 0)
+	{
+		return 0;
+	}
+	auto step = std::min(size_t(ticks), cursor);
+	if (step)
+	{
+		SeekTo(sim, cursor - step);
+	}
+	return int(step);
+}
+
+int TimeTravel::Forward(Simulation &sim, int ticks)
+{
+	if (frames.empty() || ticks <= 0)
+	{
+		return 0;
+	}
+	auto step = std::min(size_t(ticks), frames.size() - 1U - cursor);
+	if (step)
+	{
+		SeekTo(sim, cursor + step);
+	}
+	return int(step);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "DeltaCompressor.h"
+#include <cstddef>
+#include <deque>
+#include <memory>
+
+class Simulation;
+class Snapshot;
+struct SnapshotDelta;
+
+// A ring buffer of the states the simulation went through, for rewinding it. Every recorded
+// tick is stored as a SnapshotDelta from the tick before it, except every keyframeInterval
+// ticks, when it's stored as a SnapshotDelta from a blank Snapshot, a keyframe, so that any
+// tick can be rebuilt starting from the keyframe before it. All of these are compressed in
+// the background. The budget is checked after every tick, counting the SnapshotDeltas as well
+// as the blank Snapshot and the one of the current tick. When it's exceeded, the oldest
+// keyframe and the ticks that depend on it are dropped. If only one keyframe is left and that's
+// still too much, the newest tick is made a keyframe and everything before it is dropped.
+class TimeTravel
+{
+public:
+	static constexpr int keyframeInterval = 60;
+
+private:
+	struct Frame
+	{
+		bool keyframe;
+		std::unique_ptr<SnapshotDelta> delta;
+	};
+	std::deque<Frame> frames; // frames[0] is always a keyframe
+	size_t cursor = 0; // the frame the simulation is at, meaningless if frames is empty
+	int sinceKeyframe = 0;
+	size_t budget;
+	std::unique_ptr<Snapshot> blank;
+	std::unique_ptr<Snapshot> last; // the state at cursor
+	DeltaCompressor compressor;
+
+	void DropFront(size_t count);
+	void DropBack(size_t count);
+	void SeekTo(Simulation &sim, size_t target);
+	size_t Bytes() const;
+	void EnforceBudget(Simulation &sim);
+
+public:
+	TimeTravel(size_t newBudget);
+	~TimeTravel();
+
+	size_t GetBudget() const
+	{
+		return budget;
+	}
+
+	void SetBudget(size_t newBudget)
+	{
+		budget = newBudget;
+	}
+
+	// Call after every tick the simulation advances. If the simulation had been rewound, the
+	// ticks after the one it was rewound to are forgotten.
+	void Record(Simulation &sim);
+
+	// Both restore the state of the simulation from the given number of ticks earlier or
+	// later, or as far as recorded, and return how many ticks they went.
+	int Back(Simulation &sim, int ticks);
+	int Forward(Simulation &sim, int ticks);
+};
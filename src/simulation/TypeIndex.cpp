@@ -0,0 +1,32 @@
+#include "TypeIndex.h"
+#include <algorithm>
+
+TypeIndex::TypeIndex() : listedType(NPART, 0), position(NPART, 0), serial(NPART, 0)
+{
+}
+
+void TypeIndex::Clear()
+{
+	for (auto &list : ids)
+	{
+		for (auto i : list)
+		{
+			listedType[i] = 0;
+		}
+		list.clear();
+	}
+	for (auto &log : added)
+	{
+		log.clear();
+	}
+}
+
+void TypeIndex::Sort(int t)
+{
+	auto &list = ids[t];
+	std::sort(list.begin(), list.end());
+	for (int p = 0; p < int(list.size()); p++)
+	{
+		position[list[p]] = p;
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "SimulationConfig.h"
+#include "ElementDefs.h"
+#include <array>
+#include <vector>
+
+// IDs of the particles of each element type, in no particular order. Simulation updates
+// these in create_part, kill_part and part_change_type, and RecalcFreeParticles corrects
+// the lists of particles whose type was changed any other way, so until then users should
+// still check parts[i].type. A particle is in at most one list.
+class TypeIndex
+{
+public:
+	// A particle as it was when it was put in a list. It's still in that list if its serial
+	// hasn't changed since.
+	struct Entry
+	{
+		int i;
+		unsigned int serial;
+	};
+
+private:
+	std::array<std::vector<int>, PT_NUM> ids;
+	std::vector<int> listedType; // per particle, the list it is in, 0 if none
+	std::vector<int> position; // per particle, its index in that list
+	std::vector<unsigned int> serial; // per particle, bumped every time it is put in a list
+	std::array<bool, PT_NUM> watched{};
+	std::array<std::vector<Entry>, PT_NUM> added;
+
+public:
+	TypeIndex();
+
+	void Clear();
+
+	// Puts the particle in the list of type t, taking it out of its previous one.
+	void Add(int i, int t)
+	{
+		if (listedType[i] == t)
+			return;
+		Remove(i);
+		if (t > 0 && t < PT_NUM)
+		{
+			listedType[i] = t;
+			position[i] = int(ids[t].size());
+			ids[t].push_back(i);
+			serial[i] += 1;
+			if (watched[t])
+				added[t].push_back({ i, serial[i] });
+		}
+	}
+
+	void Remove(int i)
+	{
+		auto t = listedType[i];
+		if (!t)
+			return;
+		auto &list = ids[t];
+		auto last = list.back();
+		list[position[i]] = last;
+		position[last] = position[i];
+		list.pop_back();
+		listedType[i] = 0;
+	}
+
+	const std::vector<int> &Get(int t) const
+	{
+		return ids[t];
+	}
+
+	int TypeOf(int i) const
+	{
+		return listedType[i];
+	}
+
+	unsigned int Serial(int i) const
+	{
+		return serial[i];
+	}
+
+	// Starts logging the particles put in the list of type t, see Added.
+	void Watch(int t)
+	{
+		watched[t] = true;
+	}
+
+	// Particles put in the list of type t since the log was last cleared by the caller,
+	// if t is watched. Entries whose serial is out of date have since left the list.
+	std::vector<Entry> &Added(int t)
+	{
+		return added[t];
+	}
+
+	// Restores ascending order for passes whose results depend on the order of particles.
+	void Sort(int t);
+};
@@ -1,4 +1,5 @@
 #include "simulation/ElementCommon.h"
+#include <algorithm>
 
 static int update(UPDATE_FUNC_ARGS);
 
@@ -77,23 +78,64 @@ static int update(UPDATE_FUNC_ARGS)
 	}
 	bool setFilt = false;
 	int photonWl = 0;
-	for (rx=-rd; rx<rd+1; rx++)
-		for (ry=-rd; ry<rd+1; ry++)
-			if (x+rx>=0 && y+ry>=0 && x+rx<XRES && y+ry<YRES && (rx || ry))
+	auto detect = [parts, i](int r) {
+		if (TYP(r) == parts[i].ctype && (parts[i].ctype != PT_LIFE || parts[i].tmp == parts[ID(r)].ctype || !parts[i].tmp))
+			parts[i].life = 1;
+		return TYP(r) == PT_PHOT || (TYP(r) == PT_BRAY && parts[ID(r)].tmp!=2) || TYP(r) == PT_BIZR || TYP(r) == PT_BIZRG || TYP(r) == PT_BIZRS;
+	};
+	// Only particles of these types matter, so if there are fewer of them than pixels in range,
+	// going through them is cheaper than going through the pixels.
+	int searchTypes[] = { parts[i].ctype, PT_PHOT, PT_BRAY, PT_BIZR, PT_BIZRG, PT_BIZRS };
+	size_t candidates = 0;
+	for (auto t : searchTypes)
+		if (t > 0 && t < PT_NUM)
+			candidates += sim->typeIndex.Get(t).size();
+	if (candidates < size_t((2*rd+1)*(2*rd+1)))
+	{
+		// The pixel scan below goes column by column, so the photon it finds last sets the wavelength
+		int photonPos = -1;
+		for (int s = 0; s < int(std::size(searchTypes)); s++)
+		{
+			auto t = searchTypes[s];
+			if (t <= 0 || t >= PT_NUM || std::find(searchTypes, searchTypes+s, t) != searchTypes+s)
+				continue;
+			for (auto j : sim->typeIndex.Get(t))
 			{
-				r = pmap[y+ry][x+rx];
-				if(!r)
-					r = sim->photons[y+ry][x+rx];
-				if(!r)
+				int nx = int(parts[j].x+0.5f), ny = int(parts[j].y+0.5f);
+				if (nx<0 || ny<0 || nx>=XRES || ny>=YRES || std::abs(nx-x)>rd || std::abs(ny-y)>rd || (nx==x && ny==y))
+					continue;
+				r = pmap[ny][nx];
+				if (!r)
+					r = sim->photons[ny][nx];
+				if (!r || ID(r) != j)
 					continue;
-				if (TYP(r) == parts[i].ctype && (parts[i].ctype != PT_LIFE || parts[i].tmp == parts[ID(r)].ctype || !parts[i].tmp))
-					parts[i].life = 1;
-				if (TYP(r) == PT_PHOT || (TYP(r) == PT_BRAY && parts[ID(r)].tmp!=2) || TYP(r) == PT_BIZR || TYP(r) == PT_BIZRG || TYP(r) == PT_BIZRS)
+				if (detect(r) && nx*YRES+ny > photonPos)
 				{
 					setFilt = true;
 					photonWl = parts[ID(r)].ctype;
+					photonPos = nx*YRES+ny;
 				}
 			}
+		}
+	}
+	else
+	{
+		for (rx=-rd; rx<rd+1; rx++)
+			for (ry=-rd; ry<rd+1; ry++)
+				if (x+rx>=0 && y+ry>=0 && x+rx<XRES && y+ry<YRES && (rx || ry))
+				{
+					r = pmap[y+ry][x+rx];
+					if(!r)
+						r = sim->photons[y+ry][x+rx];
+					if(!r)
+						continue;
+					if (detect(r))
+					{
+						setFilt = true;
+						photonWl = parts[ID(r)].ctype;
+					}
+				}
+	}
 	if (setFilt)
 	{
 		int nx, ny;
@@ -103,6 +103,10 @@ int Element_ETRD_nearestSparkablePart(Simulation *sim, int targetId)
 	int foundDistance = XRES + YRES;
 	int foundI = -1;
 	ui::Point targetPos = ui::Point(int(parts[targetId].x), int(parts[targetId].y));
+	// The type index isn't in ID order, lower IDs win ties like they would in a scan of parts
+	auto closer = [&foundDistance, &foundI](int checkDistance, int i) {
+		return checkDistance < foundDistance || (checkDistance == foundDistance && foundI >= 0 && i < foundI);
+	};
 
 	if (sim->etrd_count_valid)
 	{
@@ -134,36 +138,29 @@ int Element_ETRD_nearestSparkablePart(Simulation *sim, int targetId)
 				}
 			}
 		}
-		// If neighbor search didn't find a suitable particle, search all particles
+		// If neighbor search didn't find a suitable particle, search outwards from the target
 		if (foundI < 0)
 		{
-			for (int i = 0; i <= sim->parts_lastActiveIndex; i++)
-			{
-				if (parts[i].type == PT_ETRD && !parts[i].life)
-				{
-					ui::Point checkPos = ui::Point(int(parts[i].x)-targetPos.X, int(parts[i].y)-targetPos.Y);
-					int checkDistance = std::abs(checkPos.X) + std::abs(checkPos.Y);
-					if (checkDistance < foundDistance && i != targetId)
-					{
-						foundDistance = checkDistance;
-						foundI = i;
-					}
-				}
-			}
+			foundI = sim->spatialIndex.Nearest(PT_ETRD, targetPos.X, targetPos.Y, [parts, targetPos, targetId](int i) {
+				if (parts[i].type != PT_ETRD || parts[i].life || i == targetId)
+					return -1;
+				ui::Point checkPos = ui::Point(int(parts[i].x)-targetPos.X, int(parts[i].y)-targetPos.Y);
+				return std::abs(checkPos.X) + std::abs(checkPos.Y);
+			});
 		}
 	}
 	else
 	{
 		// Recalculate countLife0, and search for the closest suitable particle
 		int countLife0 = 0;
-		for (int i = 0; i <= sim->parts_lastActiveIndex; i++)
+		for (auto i : sim->typeIndex.Get(PT_ETRD))
 		{
 			if (parts[i].type == PT_ETRD && !parts[i].life)
 			{
 				countLife0++;
 				ui::Point checkPos = ui::Point(int(parts[i].x)-targetPos.X, int(parts[i].y)-targetPos.Y);
 				int checkDistance = std::abs(checkPos.X) + std::abs(checkPos.Y);
-				if (checkDistance < foundDistance && i != targetId)
+				if (closer(checkDistance, i) && i != targetId)
 				{
 					foundDistance = checkDistance;
 					foundI = i;
@@ -305,10 +305,9 @@ static int MoveStack(Simulation * sim, int stackX, int stackY, int directionX, i
 				int jP = tempParts[j];
 				int srcX = (int)(sim->parts[jP].x + 0.5f), srcY = (int)(sim->parts[jP].y + 0.5f);
 				int destX = srcX-directionX*amount, destY = srcY-directionY*amount;
-				sim->pmap[srcY][srcX] = 0;
 				sim->parts[jP].x = float(destX);
 				sim->parts[jP].y = float(destY);
-				sim->pmap[destY][destX] = PMAP(jP, sim->parts[jP].type);
+				sim->PmapAdd(jP, destX, destY);
 			}
 			return amount;
 		}
@@ -328,10 +327,9 @@ static int MoveStack(Simulation * sim, int stackX, int stackY, int directionX, i
 					continue;
 				int srcX = (int)(sim->parts[jP].x + 0.5f), srcY = (int)(sim->parts[jP].y + 0.5f);
 				int destX = srcX+directionX*possibleMovement, destY = srcY+directionY*possibleMovement;
-				sim->pmap[srcY][srcX] = 0;
 				sim->parts[jP].x = float(destX);
 				sim->parts[jP].y = float(destY);
-				sim->pmap[destY][destX] = PMAP(jP, sim->parts[jP].type);
+				sim->PmapAdd(jP, destX, destY);
 			}
 			return possibleMovement;
 		}
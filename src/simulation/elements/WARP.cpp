@@ -76,8 +76,8 @@ static int update(UPDATE_FUNC_ARGS)
 				parts[ID(r)].vx = RNG::Ref().between(-2, 1) + 0.5f;
 				parts[ID(r)].vy = float(RNG::Ref().between(-2, 1));
 				parts[i].life += 4;
-				pmap[y][x] = r;
-				pmap[y + ry][x + rx] = PMAP(i, parts[i].type);
+				sim->PmapAdd(ID(r), x, y);
+				sim->PmapAdd(i, x + rx, y + ry);
 				trade = 5;
 			}
 		}
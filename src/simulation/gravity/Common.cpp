@@ -1,10 +1,8 @@
 #include "Gravity.h"
-#include "simulation/CoordStack.h"
 #include "simulation/Simulation.h"
 #include "simulation/SimulationData.h"
 #include "Misc.h"
 #include <cmath>
-#include <iostream>
 #include <sys/types.h>
 
 Gravity::Gravity(CtorTag)
@@ -19,6 +17,7 @@ Gravity::Gravity(CtorTag)
 	gravx.resize(NCELL);
 	gravp.resize(NCELL);
 	gravmask.resize(NCELL);
+	maskStack.reserve(NCELL);
 }
 
 Gravity::~Gravity()
@@ -143,145 +142,43 @@ void Gravity::stop_grav_async()
 	std::fill(&gravmap[0], &gravmap[0] + NCELL, 0.0f);
 }
 
-bool Gravity::grav_mask_r(int x, int y, char checkmap[YCELLS][XCELLS], char shape[YCELLS][XCELLS])
+void Gravity::gravity_mask()
 {
-	int x1, x2;
-	bool ret = false;
-	try
-	{
-		CoordStack cs;
-		cs.push(x, y);
-		do
+	// Cells that aren't gravity walls and are connected to the edge of the simulation
+	// through other such cells let gravity through, the rest are enclosed by gravity walls.
+	std::fill(&gravmask[0], &gravmask[0] + NCELL, 0);
+	maskStack.clear();
+	auto visit = [this](int x, int y) {
+		auto i = y * XCELLS + x;
+		if (bmap[y][x] != WL_GRAV && !gravmask[i])
 		{
-			cs.pop(x, y);
-			x1 = x2 = x;
-			while (x1 >= 0)
-			{
-				if (x1 == 0)
-				{
-					ret = true;
-					break;
-				}
-				else if (checkmap[y][x1-1] || bmap[y][x1-1] == WL_GRAV)
-					break;
-				x1--;
-			}
-			while (x2 <= XCELLS-1)
-			{
-				if (x2 == XCELLS-1)
-				{
-					ret = true;
-					break;
-				}
-				else if (checkmap[y][x2+1] || bmap[y][x2+1] == WL_GRAV)
-					break;
-				x2++;
-			}
-			for (x = x1; x <= x2; x++)
-			{
-				shape[y][x] = 1;
-				checkmap[y][x] = 1;
-			}
-			if (y == 0)
-			{
-				for (x = x1; x <= x2; x++)
-					if (bmap[y][x] != WL_GRAV)
-						ret = true;
-			}
-			else if (y >= 1)
-			{
-				for (x = x1; x <= x2; x++)
-					if (!checkmap[y-1][x] && bmap[y-1][x] != WL_GRAV)
-					{
-						if (y-1 == 0)
-							ret = true;
-						cs.push(x, y-1);
-					}
-			}
-			if (y < YCELLS-1)
-				for (x=x1; x<=x2; x++)
-					if (!checkmap[y+1][x] && bmap[y+1][x] != WL_GRAV)
-					{
-						if (y+1 == YCELLS-1)
-							ret = true;
-						cs.push(x, y+1);
-					}
-		} while (cs.getSize()>0);
-	}
-	catch (std::exception& e)
+			gravmask[i] = 0xFFFFFFFF;
+			maskStack.push_back(i);
+		}
+	};
+	for (int x = 0; x < XCELLS; x++)
 	{
-		std::cerr << e.what() << std::endl;
-		ret = false;
+		visit(x, 0);
+		visit(x, YCELLS-1);
 	}
-	return ret;
-}
-void Gravity::mask_free(mask_el *c_mask_el)
-{
-	if (c_mask_el == nullptr)
-		return;
-	delete[] c_mask_el->next;
-	delete[] c_mask_el->shape;
-	delete[] c_mask_el;
-}
-
-void Gravity::gravity_mask()
-{
-	char checkmap[YCELLS][XCELLS];
-	unsigned maskvalue;
-	mask_el *t_mask_el = nullptr;
-	mask_el *c_mask_el = nullptr;
-	memset(checkmap, 0, sizeof(checkmap));
-	for (int x = 0; x < XCELLS; x++)
+	for (int y = 0; y < YCELLS; y++)
 	{
-		for(int y = 0; y < YCELLS; y++)
-		{
-			if (bmap[y][x] != WL_GRAV && checkmap[y][x] == 0)
-			{
-				// Create a new shape
-				if (t_mask_el == nullptr)
-				{
-					t_mask_el = new mask_el[sizeof(mask_el)];
-					t_mask_el->shape = new char[NCELL];
-					std::fill(&t_mask_el->shape[0], &t_mask_el->shape[0] + NCELL, 0);
-					t_mask_el->shapeout = 0;
-					t_mask_el->next = nullptr;
-					c_mask_el = t_mask_el;
-				}
-				else
-				{
-					c_mask_el->next = new mask_el[sizeof(mask_el)];
-					c_mask_el = c_mask_el->next;
-					c_mask_el->shape = new char[NCELL];
-					std::fill(&c_mask_el->shape[0], &c_mask_el->shape[0] + NCELL, 0);
-					c_mask_el->shapeout = 0;
-					c_mask_el->next = nullptr;
-				}
-				// Fill the shape
-				if (grav_mask_r(x, y, checkmap, reinterpret_cast<char(*)[XCELLS]>(c_mask_el->shape)))
-					c_mask_el->shapeout = 1;
-			}
-		}
+		visit(0, y);
+		visit(XCELLS-1, y);
 	}
-	c_mask_el = t_mask_el;
-	std::fill(&gravmask[0], &gravmask[0] + NCELL, 0);
-	while (c_mask_el != nullptr)
+	while (!maskStack.empty())
 	{
-		char *cshape = c_mask_el->shape;
-		for (int x = 0; x < XCELLS; x++)
-		{
-			for (int y = 0; y < YCELLS; y++)
-			{
-				if (cshape[y * XCELLS + x])
-				{
-					if (c_mask_el->shapeout)
-						maskvalue = 0xFFFFFFFF;
-					else
-						maskvalue = 0x00000000;
-					gravmask[y * XCELLS + x] = maskvalue;
-				}
-			}
-		}
-		c_mask_el = c_mask_el->next;
+		auto i = maskStack.back();
+		maskStack.pop_back();
+		int x = i % XCELLS;
+		int y = i / XCELLS;
+		if (x > 0)
+			visit(x-1, y);
+		if (x < XCELLS-1)
+			visit(x+1, y);
+		if (y > 0)
+			visit(x, y-1);
+		if (y < YCELLS-1)
+			visit(x, y+1);
 	}
-	mask_free(t_mask_el);
 }
@@ -1,8 +1,11 @@
 #include "Gravity.h"
 #include "Misc.h"
+#include <algorithm>
 #include <cstring>
 #include <cmath>
 #include <complex>
+#include <mutex>
+#include <thread>
 #include <fftw3.h>
 
 constexpr auto xblock2     = XCELLS * 2;
@@ -10,6 +13,12 @@ constexpr auto yblock2     = YCELLS * 2;
 constexpr auto fft_tsize   = (xblock2 / 2 + 1) * yblock2;
 //NCELL*4 is size of data array, scaling needed because FFTW calculates an unnormalized DFT
 constexpr auto scaleFactor = -float(M_GRAV) / (NCELL * 4);
+//the transforms are small, more threads than this only add overhead
+constexpr unsigned int maxFftThreads = 4;
+//incremental updates pile up rounding errors, redo the whole field with FFTs at least this often
+constexpr int maxIncrementalUpdates = 100;
+
+static ByteString fftWisdomFile;
 
 static_assert(sizeof(std::complex<float>) == sizeof(fftwf_complex));
 struct FftwArrayDeleter        { void operator ()(float               ptr[]) const { fftwf_free(ptr);         } };
@@ -34,7 +43,17 @@ struct GravityImpl : public Gravity
 	FftwComplexArrayPtr th_ptgravxt, th_ptgravyt, th_gravmapbigt, th_gravxbigt, th_gravybigt;
 	FftwPlanPtr plan_gravmap, plan_gravx_inverse, plan_gravy_inverse;
 
+	// Velocity maps of a point mass in the middle, as used before transforming them but
+	// without the FFT scaling, for incremental updates.
+	std::vector<float> th_kernelx, th_kernely;
+	// Masked gravmap and the resulting field of the last update.
+	std::vector<float> th_lastgravmap, th_lastgravx, th_lastgravy;
+	std::vector<int> th_changedcells;
+	int incrementalUpdates = 0;
+
 	void grav_fft_init();
+	void update_grav_fft(const float *gravmap);
+	void update_grav_incremental();
 	void grav_fft_cleanup();
 
 	GravityImpl() : Gravity(CtorTag{})
@@ -50,11 +69,30 @@ GravityImpl::~GravityImpl()
 	grav_fft_cleanup();
 }
 
+void Gravity::SetFftWisdomFile(ByteString newFftWisdomFile)
+{
+	fftWisdomFile = newFftWisdomFile;
+}
+
 void GravityImpl::grav_fft_init()
 {
 	if (grav_fft_status) return;
 	FftwPlanPtr plan_ptgravx, plan_ptgravy;
 
+	if constexpr (FFTW_THREADS)
+	{
+		static std::once_flag initThreads;
+		std::call_once(initThreads, []() {
+			fftwf_init_threads();
+		});
+		fftwf_plan_with_nthreads(int(std::clamp(std::thread::hardware_concurrency(), 1U, maxFftThreads)));
+	}
+	//plans made with FFTW_MEASURE take a while, reuse them from earlier runs if possible
+	if (fftWisdomFile.size())
+	{
+		fftwf_import_wisdom_from_filename(fftWisdomFile.c_str());
+	}
+
 	//use fftw malloc function to ensure arrays are aligned, to get better performance
 	FftwArrayPtr th_ptgravx = FftwArray(xblock2 * yblock2);
 	FftwArrayPtr th_ptgravy = FftwArray(xblock2 * yblock2);
@@ -73,8 +111,14 @@ void GravityImpl::grav_fft_init()
 	plan_gravmap = FftwPlanPtr(fftwf_plan_dft_r2c_2d(yblock2, xblock2, th_gravmapbig.get(), reinterpret_cast<fftwf_complex *>(th_gravmapbigt.get()), FFTW_MEASURE));
 	plan_gravx_inverse = FftwPlanPtr(fftwf_plan_dft_c2r_2d(yblock2, xblock2, reinterpret_cast<fftwf_complex *>(th_gravxbigt.get()), th_gravxbig.get(), FFTW_MEASURE));
 	plan_gravy_inverse = FftwPlanPtr(fftwf_plan_dft_c2r_2d(yblock2, xblock2, reinterpret_cast<fftwf_complex *>(th_gravybigt.get()), th_gravybig.get(), FFTW_MEASURE));
+	if (fftWisdomFile.size())
+	{
+		fftwf_export_wisdom_to_filename(fftWisdomFile.c_str());
+	}
 
 	//calculate velocity map caused by a point mass
+	th_kernelx.assign(xblock2 * yblock2, 0.0f);
+	th_kernely.assign(xblock2 * yblock2, 0.0f);
 	for (int y = 0; y < yblock2; y++)
 	{
 		for (int x = 0; x < xblock2; x++)
@@ -84,10 +128,15 @@ void GravityImpl::grav_fft_init()
 			auto distance = hypotf(float(x-XCELLS), float(y-YCELLS));
 			th_ptgravx[y * xblock2 + x] = scaleFactor * (x - XCELLS) / powf(distance, 3);
 			th_ptgravy[y * xblock2 + x] = scaleFactor * (y - YCELLS) / powf(distance, 3);
+			th_kernelx[y * xblock2 + x] = -float(M_GRAV) * (x - XCELLS) / powf(distance, 3);
+			th_kernely[y * xblock2 + x] = -float(M_GRAV) * (y - YCELLS) / powf(distance, 3);
 		}
 	}
 	th_ptgravx[yblock2 * xblock2 / 2 + xblock2 / 2] = 0.0f;
 	th_ptgravy[yblock2 * xblock2 / 2 + xblock2 / 2] = 0.0f;
+	th_lastgravmap.assign(NCELL, 0.0f);
+	th_lastgravx.assign(NCELL, 0.0f);
+	th_lastgravy.assign(NCELL, 0.0f);
 
 	//transform point mass velocity maps
 	fftwf_execute(plan_ptgravx.get());
@@ -112,56 +161,114 @@ void Gravity::get_result()
 	std::swap(gravp, th_gravp);
 }
 
+void GravityImpl::update_grav_fft(const float *gravmap)
+{
+	//copy gravmap into padded gravmap array
+	for (int y = 0; y < YCELLS; y++)
+	{
+		std::copy(gravmap + y*XCELLS, gravmap + (y+1)*XCELLS, th_gravmapbig.get() + (y+YCELLS)*xblock2 + XCELLS);
+	}
+	//transform gravmap
+	fftwf_execute(plan_gravmap.get());
+	//do convolution (multiply the complex numbers)
+	auto *gravmapbigt = th_gravmapbigt.get();
+	auto *ptgravxt = th_ptgravxt.get();
+	auto *ptgravyt = th_ptgravyt.get();
+	auto *gravxbigt = th_gravxbigt.get();
+	auto *gravybigt = th_gravybigt.get();
+	for (int i = 0; i < fft_tsize; i++)
+	{
+		gravxbigt[i] = gravmapbigt[i] * ptgravxt[i];
+		gravybigt[i] = gravmapbigt[i] * ptgravyt[i];
+	}
+	//inverse transform, and copy from padded arrays into normal velocity maps
+	fftwf_execute(plan_gravx_inverse.get());
+	fftwf_execute(plan_gravy_inverse.get());
+	for (int y = 0; y < YCELLS; y++)
+	{
+		std::copy(th_gravxbig.get() + y*xblock2, th_gravxbig.get() + y*xblock2 + XCELLS, &th_lastgravx[y*XCELLS]);
+		std::copy(th_gravybig.get() + y*xblock2, th_gravybig.get() + y*xblock2 + XCELLS, &th_lastgravy[y*XCELLS]);
+	}
+}
+
+// Adds the field of each changed cell's mass difference to the last field. Each costs
+// about as much as two passes over the maps, so this only pays off for a few cells.
+void GravityImpl::update_grav_incremental()
+{
+	auto *gravx = &th_lastgravx[0];
+	auto *gravy = &th_lastgravy[0];
+	for (auto i : th_changedcells)
+	{
+		int cx = i % XCELLS;
+		int cy = i / XCELLS;
+		auto mass = th_gravmap[i] - th_lastgravmap[i];
+		for (int y = 0; y < YCELLS; y++)
+		{
+			// the point mass is in the middle of the kernel, at (XCELLS, YCELLS)
+			auto *kernelx = &th_kernelx[(y-cy+YCELLS)*xblock2 + XCELLS-cx];
+			auto *kernely = &th_kernely[(y-cy+YCELLS)*xblock2 + XCELLS-cx];
+			auto *rowx = gravx + y*XCELLS;
+			auto *rowy = gravy + y*XCELLS;
+			for (int x = 0; x < XCELLS; x++)
+			{
+				rowx[x] += mass * kernelx[x];
+				rowy[x] += mass * kernely[x];
+			}
+		}
+	}
+}
+
 void Gravity::update_grav()
 {
 	auto *fftGravity = static_cast<GravityImpl *>(this);
 	if (!fftGravity->grav_fft_status)
 		fftGravity->grav_fft_init();
 
-	auto *th_gravmapbig = fftGravity->th_gravmapbig.get();
-	auto *th_gravxbig = fftGravity->th_gravxbig.get();
-	auto *th_gravybig = fftGravity->th_gravybig.get();
-	auto *th_ptgravxt = fftGravity->th_ptgravxt.get();
-	auto *th_ptgravyt = fftGravity->th_ptgravyt.get();
-	auto *th_gravmapbigt = fftGravity->th_gravmapbigt.get();
-	auto *th_gravxbigt = fftGravity->th_gravxbigt.get();
-	auto *th_gravybigt = fftGravity->th_gravybigt.get();
-	auto &plan_gravmap = fftGravity->plan_gravmap;
-	auto &plan_gravx_inverse = fftGravity->plan_gravx_inverse;
-	auto &plan_gravy_inverse = fftGravity->plan_gravy_inverse;
-
 	if (memcmp(&th_ogravmap[0], &th_gravmap[0], sizeof(float) * NCELL) != 0)
 	{
 		th_gravchanged = 1;
 
-		membwand(&th_gravmap[0], &gravmask[0], NCELL * sizeof(float), NCELL * sizeof(uint32_t));
-		//copy gravmap into padded gravmap array
-		for (int y = 0; y < YCELLS; y++)
+		// raw pointers, indexing the vectors directly keeps the loops below from vectorising
+		auto *gravmap = &th_gravmap[0];
+		auto *lastgravmap = &fftGravity->th_lastgravmap[0];
+		auto *gravx = &th_gravx[0];
+		auto *gravy = &th_gravy[0];
+		auto *gravp = &th_gravp[0];
+
+		membwand(gravmap, &gravmask[0], NCELL * sizeof(float), NCELL * sizeof(uint32_t));
+
+		int threshold = incrementalThreshold;
+		bool incremental = threshold > 0 && fftGravity->incrementalUpdates < maxIncrementalUpdates;
+		auto &changedCells = fftGravity->th_changedcells;
+		changedCells.clear();
+		for (int i = 0; i < NCELL && incremental; i++)
 		{
-			for (int x = 0; x < XCELLS; x++)
+			if (gravmap[i] != lastgravmap[i])
 			{
-				th_gravmapbig[(y+YCELLS)*xblock2+XCELLS+x] = th_gravmap[y*XCELLS+x];
+				incremental = int(changedCells.size()) < threshold;
+				changedCells.push_back(i);
 			}
 		}
-		//transform gravmap
-		fftwf_execute(plan_gravmap.get());
-		//do convolution (multiply the complex numbers)
-		for (int i = 0; i < fft_tsize; i++)
+		if (incremental)
 		{
-			th_gravxbigt[i] = th_gravmapbigt[i] * th_ptgravxt[i];
-			th_gravybigt[i] = th_gravmapbigt[i] * th_ptgravyt[i];
+			fftGravity->update_grav_incremental();
+			fftGravity->incrementalUpdates++;
 		}
-		//inverse transform, and copy from padded arrays into normal velocity maps
-		fftwf_execute(plan_gravx_inverse.get());
-		fftwf_execute(plan_gravy_inverse.get());
-		for (int y = 0; y < YCELLS; y++)
+		else
 		{
-			for (int x = 0; x < XCELLS; x++)
-			{
-				th_gravx[y*XCELLS+x] = th_gravxbig[y*xblock2+x];
-				th_gravy[y*XCELLS+x] = th_gravybig[y*xblock2+x];
-				th_gravp[y*XCELLS+x] = hypotf(th_gravxbig[y*xblock2+x], th_gravybig[y*xblock2+x]);
-			}
+			fftGravity->update_grav_fft(gravmap);
+			fftGravity->incrementalUpdates = 0;
+		}
+		std::copy(gravmap, gravmap + NCELL, lastgravmap);
+
+		auto *lastgravx = &fftGravity->th_lastgravx[0];
+		auto *lastgravy = &fftGravity->th_lastgravy[0];
+		std::copy(lastgravx, lastgravx + NCELL, gravx);
+		std::copy(lastgravy, lastgravy + NCELL, gravy);
+		for (int i = 0; i < NCELL; i++)
+		{
+			// not hypotf, which is a library call, the values are nowhere near overflowing
+			gravp[i] = std::sqrt(lastgravx[i]*lastgravx[i] + lastgravy[i]*lastgravy[i]);
 		}
 	}
 	else
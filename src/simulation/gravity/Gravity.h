@@ -2,12 +2,14 @@
 #include "Config.h"
 #include "GravityPtr.h"
 #include "SimulationConfig.h"
+#include "common/String.h"
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
 #include <vector>
 #include <cstdint>
+#include <atomic>
 
 class Simulation;
 
@@ -25,6 +27,9 @@ protected:
 
 	int th_gravchanged = 0;
 
+	// Read by the gravity thread, see SetIncrementalThreshold.
+	std::atomic<int> incrementalThreshold = 64;
+
 	std::thread gravthread;
 	std::mutex gravmutex;
 	std::condition_variable gravcv;
@@ -32,15 +37,7 @@ protected:
 	int gravthread_done = 0;
 	bool ignoreNextResult = false;
 
-	struct mask_el {
-		char *shape;
-		char shapeout;
-		mask_el *next;
-	};
-	using mask_el = struct mask_el;
-
-	bool grav_mask_r(int x, int y, char checkmap[YCELLS][XCELLS], char shape[YCELLS][XCELLS]);
-	void mask_free(mask_el *c_mask_el);
+	std::vector<int> maskStack; // cells gravity_mask still has to look at the neighbours of
 
 	void update_grav();
 	void get_result();
@@ -75,4 +72,20 @@ public:
 	void gravity_mask();
 
 	static GravityPtr Create();
+
+	// Where FFTW keeps the plans it measured between runs, nothing is saved if empty.
+	static void SetFftWisdomFile(ByteString newFftWisdomFile);
+
+	// If the mass changed in at most this many cells since the last update, the gravity
+	// field is updated by adding up the field of each change rather than with FFTs. 0
+	// always uses FFTs.
+	void SetIncrementalThreshold(int newIncrementalThreshold)
+	{
+		incrementalThreshold = newIncrementalThreshold;
+	}
+
+	int GetIncrementalThreshold() const
+	{
+		return incrementalThreshold;
+	}
 };
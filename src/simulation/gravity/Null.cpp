@@ -15,6 +15,10 @@ void Gravity::update_grav(void)
 {
 }
 
+void Gravity::SetFftWisdomFile(ByteString newFftWisdomFile)
+{
+}
+
 GravityPtr Gravity::Create()
 {
 	return GravityPtr(new Gravity(CtorTag{}));
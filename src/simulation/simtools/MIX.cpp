@@ -41,13 +41,13 @@ static int perform(Simulation * sim, Particle * cpart, int x, int y, int brushX,
 	if ((sim->elements[TYP(thisPart)].Properties&STATE_FLAGS) != (sim->elements[TYP(thatPart)].Properties&STATE_FLAGS))
 		return 0;
 
-	sim->pmap[y][x] = thatPart;
 	sim->parts[ID(thatPart)].x = float(x);
 	sim->parts[ID(thatPart)].y = float(y);
+	sim->PmapAdd(ID(thatPart), x, y);
 
-	sim->pmap[newY][newX] = thisPart;
 	sim->parts[ID(thisPart)].x = float(newX);
 	sim->parts[ID(thisPart)].y = float(newY);
+	sim->PmapAdd(ID(thisPart), newX, newY);
 
 	return 1;
 }